@@ -0,0 +1,160 @@
+//
+// Name :         ScoreBench.cpp
+// Description :  Score loading benchmark.  Writes a synthetic score with
+//                many notes, or takes an existing one, and reports how
+//                long CSynthesizer::OpenScore takes and the most memory
+//                the process used.
+// Usage :        synthie-scorebench [-n notes] [in.score]
+//
+
+#include "pch.h"
+#include "CSynthesizer.h"
+#include "Utf8.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+static void Usage()
+{
+    cerr << "usage: synthie-scorebench [-n notes] [in.score]" << endl;
+    cerr << "  -n notes    Notes in the synthetic score (default 1000000)" << endl;
+    cerr << "  in.score    Load this score instead of a synthetic one" << endl;
+}
+
+//
+// Name :        PeakMemory()
+// Description : The most memory the process has had resident, in MB.
+//
+
+static double PeakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize / (1024. * 1024.);
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024. * 1024.);
+#else
+    return usage.ru_maxrss / 1024.;
+#endif
+#endif
+}
+
+//
+// Name :        WriteScore()
+// Description : Write a score of chords for a few tone instruments,
+//               four notes to a beat, with the attributes in the
+//               order and style of the hand written scores.
+//
+
+static bool WriteScore(const char* filename, long notes)
+{
+    static const char* names[] = { "C4", "E4", "G4", "Bb4", "C5", "D#5", "F#3", "A3" };
+    const int Instruments = 8;
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file)
+        return false;
+
+    file << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    file << "<score bpm=\"120\" beatspermeasure=\"4\">\n";
+
+    long perInstrument = (notes + Instruments - 1) / Instruments;
+    char line[160];
+
+    for (int i = 0; i < Instruments && notes > 0; i++)
+    {
+        file << "   <instrument instrument=\"ToneInstrument\">\n";
+
+        for (long n = 0; n < perInstrument && notes > 0; n++, notes--)
+        {
+            long beat = n / 4;
+            snprintf(line, sizeof(line),
+                "      <note measure=\"%ld\" beat=\"%.2f\" duration=\"%.2f\" note=\"%s\"/>\n",
+                beat / 4 + 1, beat % 4 + 1 + (n % 4) * 0.25, 0.25 + (n % 3) * 0.5, names[(n + i) % 8]);
+            file << line;
+        }
+
+        file << "   </instrument>\n";
+    }
+
+    file << "</score>\n";
+    return bool(file);
+}
+
+int main(int argc, char* argv[])
+{
+    long notes = 1000000;
+    const char* filename = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc)
+        {
+            notes = atol(argv[++i]);
+        }
+        else if (arg[0] == '-')
+        {
+            Usage();
+            return 1;
+        }
+        else
+        {
+            filename = argv[i];
+        }
+    }
+
+    string temporary;
+    if (filename == NULL)
+    {
+        temporary = "synthie-scorebench.score";
+        if (!WriteScore(temporary.c_str(), notes))
+        {
+            cerr << "Unable to write " << temporary << endl;
+            return 1;
+        }
+
+        filename = temporary.c_str();
+    }
+
+    wstring scoreName = Utf8ToWide(filename, strlen(filename));
+    double before = PeakMemory();
+
+    auto start = std::chrono::steady_clock::now();
+
+    CSynthesizer synthesizer;
+    bool loaded = synthesizer.OpenScore(scoreName.c_str());
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!temporary.empty())
+        remove(temporary.c_str());
+
+    if (!loaded)
+    {
+        wcerr << synthesizer.GetError() << endl;
+        return 1;
+    }
+
+    printf("Loaded %s in %.3f seconds, %.2f seconds of score\n", filename, elapsed,
+        synthesizer.GetScoreFrames() / synthesizer.GetSampleRate());
+    printf("Peak memory %.1f MB, %.1f MB before loading\n", PeakMemory(), before);
+
+    return 0;
+}
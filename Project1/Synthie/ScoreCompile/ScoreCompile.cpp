@@ -0,0 +1,189 @@
+//
+// Name :         ScoreCompile.cpp
+// Description :  Compiles a .score file to a .scorebin that the synthesizer
+//                maps and plays with no parsing.  With -v it loads the
+//                result back and checks it against the original.
+// Usage :        synthie-scorecompile [-r rate] [-u tuning.scl] [-v] in.score [out.scorebin]
+//
+
+#include "pch.h"
+#include "CSynthesizer.h"
+#include "Utf8.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+static void Usage()
+{
+    cerr << "usage: synthie-scorecompile [-r rate] [-u tuning.scl] [-v] in.score [out.scorebin]" << endl;
+    cerr << "  -r rate     Lowest sample rate to count voices for (default 44100)" << endl;
+    cerr << "  -u file     Tune notes with a Scala .scl scale instead of equal temperament" << endl;
+    cerr << "  -v          Load the compiled score back and check it against the original" << endl;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool SameNote(const CNote& a, const CNote& b)
+{
+    return a.Instrument() == b.Instrument() && a.Measure() == b.Measure() && a.Beat() == b.Beat() &&
+        a.Duration() == b.Duration() && a.Frequency() == b.Frequency() && a.WaveIndex() == b.WaveIndex();
+}
+
+//
+// Name :        Verify()
+// Description : Everything the synthesizer plays from the two scores
+//               has to be the same.
+//
+
+static bool Verify(CSynthesizer& original, CSynthesizer& compiled)
+{
+    if (original.GetBpm() != compiled.GetBpm() || original.GetBeatsPerMeasure() != compiled.GetBeatsPerMeasure())
+    {
+        cerr << "Tempo differs" << endl;
+        return false;
+    }
+
+    if (original.GetScoreWaves() != compiled.GetScoreWaves())
+    {
+        cerr << "Wave table differs" << endl;
+        return false;
+    }
+
+    if (original.GetNumNotes() != compiled.GetNumNotes())
+    {
+        cerr << "Note count differs" << endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < original.GetNumNotes(); i++)
+    {
+        if (!SameNote(original.GetNotes()[i], compiled.GetNotes()[i]))
+        {
+            cerr << "Note " << i << " differs" << endl;
+            return false;
+        }
+    }
+
+    if (original.GetScoreFrames() != compiled.GetScoreFrames())
+    {
+        cerr << "Score length differs" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    double sampleRate = 44100;
+    bool verify = false;
+    const char* tuning = NULL;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "-r" && i + 1 < argc)
+        {
+            sampleRate = atof(argv[++i]);
+        }
+        else if (arg == "-u" && i + 1 < argc)
+        {
+            tuning = argv[++i];
+        }
+        else if (arg == "-v")
+        {
+            verify = true;
+        }
+        else if (arg[0] == '-')
+        {
+            Usage();
+            return 1;
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (files.empty() || files.size() > 2 || sampleRate <= 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    // The output defaults to the input with its extension replaced
+    string output;
+    if (files.size() == 2)
+    {
+        output = files[1];
+    }
+    else
+    {
+        output = files[0];
+        size_t dot = output.find_last_of('.');
+        size_t slash = output.find_last_of("/\\");
+        if (dot != string::npos && (slash == string::npos || dot > slash))
+            output.erase(dot);
+        output += ".scorebin";
+    }
+
+    wstring scoreName = Utf8ToWide(files[0], strlen(files[0]));
+    wstring binName = Utf8ToWide(output.c_str(), output.size());
+
+    // Stream every wave, so only the head of each is read
+    CSynthesizer original;
+    original.SetSampleRate(sampleRate);
+    original.SetStreamThreshold(1);
+
+    // Note frequencies are compiled in
+    if (tuning != NULL && !original.LoadTuning(Utf8ToWide(tuning, strlen(tuning)).c_str()))
+    {
+        wcerr << original.GetError() << endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!original.OpenScore(scoreName.c_str()))
+    {
+        wcerr << original.GetError() << endl;
+        return 1;
+    }
+
+    double parse = Seconds(start);
+
+    if (!original.SaveScoreBin(binName.c_str()))
+    {
+        wcerr << original.GetError() << endl;
+        return 1;
+    }
+
+    printf("Wrote %s, %zu notes (the score loaded in %.3f seconds)\n", output.c_str(), original.GetNumNotes(), parse);
+
+    if (!verify)
+        return 0;
+
+    CSynthesizer compiled;
+    compiled.SetSampleRate(sampleRate);
+    compiled.SetStreamThreshold(1);
+
+    start = std::chrono::steady_clock::now();
+    if (!compiled.OpenScore(binName.c_str()))
+    {
+        wcerr << compiled.GetError() << endl;
+        return 1;
+    }
+
+    double map = Seconds(start);
+
+    if (!Verify(original, compiled))
+        return 1;
+
+    printf("Verified, the compiled score loaded in %.3f seconds\n", map);
+    return 0;
+}
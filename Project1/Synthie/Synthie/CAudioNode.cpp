@@ -9,3 +9,23 @@ CAudioNode::CAudioNode()
     m_samplePeriod = 1.0 / 44100.0;
     m_bpm = 120;
 }
+
+bool CAudioNode::GenerateBlock(float* out, int frames)
+{
+    for (int i = 0; i < frames; i++)
+    {
+        if (!Generate())
+        {
+            // Done, the rest of the block is silence
+            for (int j = i * 2; j < frames * 2; j++)
+                out[j] = 0;
+
+            return false;
+        }
+
+        out[i * 2] = float(Frame(0));
+        out[i * 2 + 1] = float(Frame(1));
+    }
+
+    return true;
+}
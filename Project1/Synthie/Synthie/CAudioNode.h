@@ -8,6 +8,13 @@ public:
     //! Cause one sample to be generated
     virtual bool Generate() = 0;
 
+    //! Generate a block of audio frames
+    /*! Writes frames stereo frames, interleaved, into out. Returns
+     *  false once the node has finished; any frames after the end
+     *  are written as silence. The default implementation calls
+     *  Generate() once per frame. */
+    virtual bool GenerateBlock(float* out, int frames);
+
     //! Get the sample rate in samples per second
     double GetSampleRate() { return m_sampleRate; }
 
@@ -1,10 +1,26 @@
 #pragma once
 #include "CAudioNode.h"
 #include <CNote.h>
+
+class CVoicePoolBase;
+
 class CInstrument :
     public CAudioNode
 {
 public:
-    virtual void SetNote(CNote* note) = 0;
-};
+    CInstrument() : m_pool(NULL), m_nextFree(NULL) {}
+
+    virtual void SetNote(const CNote* note) = 0;
 
+    //! Can this voice render on a worker thread alongside other voices?
+    virtual bool IsThreadSafe() { return true; }
+
+    //! The voice pool this instrument was taken from, if any
+    CVoicePoolBase* Pool() { return m_pool; }
+
+private:
+    friend class CVoicePoolBase;
+
+    CVoicePoolBase* m_pool;     //!< Pool that owns this voice
+    CInstrument* m_nextFree;    //!< Next voice on the pool's free list
+};
@@ -0,0 +1,33 @@
+#include "pch.h"
+#include "CInstrumentRegistry.h"
+
+int CInstrumentRegistry::Register(const wchar_t* name, PoolFactory factory)
+{
+    // Registering a name again replaces its factory
+    int id = Find(name);
+    if (id != Unknown)
+    {
+        m_types[id].factory = factory;
+        return id;
+    }
+
+    Type type;
+    type.name = name;
+    type.factory = factory;
+    m_types.push_back(type);
+
+    return int(m_types.size()) - 1;
+}
+
+int CInstrumentRegistry::Find(const std::wstring& name) const
+{
+    // There are only ever a handful of types, and this
+    // is only called while a score is being loaded.
+    for (size_t i = 0; i < m_types.size(); i++)
+    {
+        if (m_types[i].name == name)
+            return int(i);
+    }
+
+    return Unknown;
+}
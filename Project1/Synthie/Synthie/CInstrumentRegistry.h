@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "CVoicePool.h"
+
+//! Maps instrument names from a score to numeric type ids
+/*! Each instrument type is registered once with the name scores use
+ *  for it and a factory for its voice pool. Names are resolved to ids
+ *  when the score is loaded, so notes only carry the id and starting
+ *  a note never has to compare strings.
+ */
+class CInstrumentRegistry
+{
+public:
+    //! Creates an empty voice pool for one instrument type
+    typedef CVoicePoolBase* (*PoolFactory)();
+
+    //! Id of a name that is not registered
+    static const int Unknown = -1;
+
+    //! Register an instrument type, returning its id
+    int Register(const wchar_t* name, PoolFactory factory);
+
+    //! The id registered for name, or Unknown
+    int Find(const std::wstring& name) const;
+
+    //! Number of registered types; ids run from 0 to Count() - 1
+    int Count() const { return int(m_types.size()); }
+
+    //! The name an id was registered with
+    const std::wstring& Name(int id) const { return m_types[id].name; }
+
+    //! Create a new, empty voice pool for an id
+    CVoicePoolBase* CreatePool(int id) const { return m_types[id].factory(); }
+
+private:
+    struct Type
+    {
+        std::wstring name;
+        PoolFactory factory;
+    };
+
+    std::vector<Type> m_types;
+};
+
+//! Pool factory for instrument type T
+template<class T> CVoicePoolBase* CreateVoicePool() { return new CVoicePool<T>(); }
@@ -3,59 +3,54 @@
 
 CNote::CNote()
 {
-	
+    m_instrument = -1;
+    m_measure = 0;
+    m_beat = 0;
+    m_duration = -1;
+    m_freq = 0;
+    m_waveIndex = 0;
 }
 
-CNote::~CNote(void)
+void CNote::XmlLoad(const CXmlReader& xml, int instrument, const CTuning& tuning)
 {
-}
-
-void CNote::XmlLoad(IXMLDOMNode* xml, std::wstring& instrument)
-{
-    // Remember the xml node and the instrument.
-    m_node = xml;
+    // Remember the instrument.
     m_instrument = instrument;
 
-    // Get a list of all attribute nodes and the
-    // length of that list
-    CComPtr<IXMLDOMNamedNodeMap> attributes;
-    xml->get_attributes(&attributes);
-    long len;
-    attributes->get_length(&len);
-
     // Loop over the list of attributes
-    for (int i = 0; i < len; i++)
+    for (int i = 0; i < xml.NumAttributes(); i++)
     {
-        // Get attribute i
-        CComPtr<IXMLDOMNode> attrib;
-        attributes->get_item(i, &attrib);
+        // Get the name and value of attribute i
+        const char* name = xml.AttributeName(i);
+        const char* value = xml.AttributeValue(i);
 
-        // Get the name of the attribute
-        CComBSTR name;
-        attrib->get_nodeName(&name);
-
-        // Get the value of the attribute.  
-        CComVariant value;
-        attrib->get_nodeValue(&value);
-
-        if (name == "measure")
+        if (strcmp(name, "measure") == 0)
         {
             // The file has measures that start at 1.  
             // We'll make them start at zero instead.
-            value.ChangeType(VT_I4);
-            m_measure = value.intVal - 1;
+            m_measure = strtol(value, NULL, 10) - 1;
         }
-        else if (name == "beat")
+        else if (strcmp(name, "beat") == 0)
         {
             // Same thing for the beats.
-            value.ChangeType(VT_R8);
-            m_beat = value.dblVal - 1;
+            m_beat = strtod(value, NULL) - 1;
+        }
+        else if (strcmp(name, "duration") == 0)
+        {
+            m_duration = strtod(value, NULL);
+        }
+        else if (strcmp(name, "note") == 0)
+        {
+            m_freq = tuning.NoteToFrequency(value);
+        }
+        else if (strcmp(name, "wave") == 0)
+        {
+            // And the wavetable waves
+            m_waveIndex = strtol(value, NULL, 10) - 1;
         }
-
     }
 }
 
-bool CNote::operator<(const CNote& b)
+bool CNote::operator<(const CNote& b) const
 {
     if (m_measure < b.m_measure)
         return true;
@@ -1,25 +1,48 @@
 #pragma once
-#include <vector>
-#include <string>
+#include <type_traits>
+#include "XmlReader.h"
+#include "CTuning.h"
+
+//! One note of a score
+/*! The note's attributes are parsed once, when the score is loaded,
+ *  into plain values. A note holds no reference to the XML it came
+ *  from, so the document can be released after loading and starting a
+ *  note only reads these fields.
+ */
 class CNote
 {
 public:
 	CNote();
-    virtual ~CNote(void);
 
     int Measure() const { return m_measure; }
     double Beat() const { return m_beat; }
-    const std::wstring& Instrument() const { return m_instrument; }
-    IXMLDOMNode* Node() { return m_node; }
-    void XmlLoad(IXMLDOMNode* xml, std::wstring& instrument);
+
+    //! Duration in beats, or less than zero if the note does not say
+    double Duration() const { return m_duration; }
+
+    //! Frequency in Hz, or zero if the note does not say
+    double Frequency() const { return m_freq; }
+
+    int WaveIndex() const { return m_waveIndex; }
+
+    //! Instrument type id from the synthesizer's CInstrumentRegistry
+    int Instrument() const { return m_instrument; }
+    void SetInstrument(int instrument) { m_instrument = instrument; }
+
+    //! Load the note from the attributes of the element xml just started
+    /*! Note names are turned into frequencies with tuning */
+    void XmlLoad(const CXmlReader& xml, int instrument, const CTuning& tuning);
 
 public:
-    bool operator<(const CNote& b);
+    bool operator<(const CNote& b) const;
 
 private:
-    std::wstring m_instrument;
+    int m_instrument;
     int m_measure;
     double m_beat;
-    CComPtr<IXMLDOMNode> m_node;
+    double m_duration;      //!< Duration in beats
+    double m_freq;          //!< Frequency in Hz
+    int m_waveIndex;        //!< Wavetable wave to play, from zero
 };
 
+static_assert(std::is_trivially_copyable<CNote>::value, "CNote must stay a plain value");
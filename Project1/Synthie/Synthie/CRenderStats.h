@@ -0,0 +1,66 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+//! Processor cycles from some fixed time
+/*! Where there is no cycle counter this counts nanoseconds instead,
+ *  which is as good for comparing one instrument with another. */
+inline unsigned long long CycleCount()
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//! A snapshot of what a synthesizer's render is doing
+/*! The synthesizer keeps one of these as it renders and publishes a
+ *  copy every 4096 frames (StatsInterval) and when the score is done,
+ *  which CSynthesizer::GetRenderStats() copies out for any thread.
+ *  Counts and times run from the last CSynthesizer::Start().
+ *
+ *  Each block goes through four phases: starting the notes that fall
+ *  in it (dispatch), rendering the voices, mixing them into the
+ *  output, and advancing the time. Rendering mixes each task's voices
+ *  into the task's buffer as it goes, which counts as rendering; only
+ *  the final sum of the task buffers counts as mixing.
+ */
+struct CRenderStats
+{
+    //! The cost of one instrument type
+    struct Instrument
+    {
+        long long samples = 0;          //!< Frames its voices have rendered
+        unsigned long long cycles = 0;  //!< Cycles its voices took, on all threads
+        double cyclesPerSample = 0;     //!< Cycles per voice frame
+        long long retired = 0;          //!< Voices retired early for being silent
+    };
+
+    int activeVoices = 0;       //!< Voices playing in the last block
+    int peakVoices = 0;         //!< Most voices playing in one block
+    long long notesStarted = 0; //!< Notes started
+    long long voicesStolen = 0; //!< Voices stopped early for notes over the polyphony limit
+    long long voicesRetired = 0;    //!< Voices retired early for being silent
+    double noteOnsPerSecond = 0;    //!< Notes started in the last second of audio
+    long long frames = 0;       //!< Frames rendered
+
+    double dispatchSeconds = 0; //!< Time starting notes
+    double renderSeconds = 0;   //!< Time rendering voices
+    double mixSeconds = 0;      //!< Time mixing voices into the output
+    double advanceSeconds = 0;  //!< Time advancing, including waking the wave streamer
+    double elapsedSeconds = 0;  //!< Time rendering blocks, all phases
+
+    //! Seconds of audio rendered per second taken; 0 before the first block
+    double realtimeFactor = 0;
+
+    //! Indexed by instrument type id
+    std::vector<Instrument> instruments;
+};
@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "CRenderThread.h"
+#include "CSynthesizer.h"
+#include <chrono>
+#include <cstring>
+
+CRenderThread::CRenderThread()
+{
+    m_synthesizer = NULL;
+    m_blockSize = 0;
+    m_blockStride = 0;
+    m_scoreFrames = 0;
+    m_head = 0;
+    m_count = 0;
+    m_finished = true;
+    m_cancel = false;
+    m_rendered = 0;
+}
+
+CRenderThread::~CRenderThread()
+{
+    Stop();
+}
+
+void CRenderThread::Start(CSynthesizer* synthesizer, int queueBlocks)
+{
+    Stop();
+
+    if (queueBlocks < 1)
+        queueBlocks = 1;
+
+    m_synthesizer = synthesizer;
+    m_blockSize = synthesizer->GetBlockSize();
+    m_blockStride = m_blockSize * synthesizer->GetNumChannels();
+    m_scoreFrames = synthesizer->GetScoreFrames();
+
+    m_blocks.assign(size_t(queueBlocks) * m_blockStride, 0.f);
+    m_frames.assign(queueBlocks, 0);
+    m_head = 0;
+    m_count = 0;
+    m_finished = false;
+    m_cancel = false;
+    m_rendered = 0;
+
+    m_thread = std::thread(&CRenderThread::ThreadLoop, this);
+}
+
+void CRenderThread::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    m_cancel = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+    }
+    m_cond.notify_all();
+
+    m_thread.join();
+}
+
+//
+// Name :        CRenderThread::Pop()
+// Description : Copy the block at the head of the queue into out. The
+//               render thread does not touch a block until it has been
+//               popped, so the copy is made without the lock.
+//
+
+int CRenderThread::Pop(float* out, int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto ready = [this] { return m_count > 0 || m_finished; };
+    if (timeoutMs < 0)
+        m_cond.wait(lock, ready);
+    else if (!m_cond.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready))
+        return -1;
+
+    if (m_count == 0)
+        return 0;
+
+    int block = m_head;
+    lock.unlock();
+
+    int frames = m_frames[block];
+    memcpy(out, &m_blocks[size_t(block) * m_blockStride], size_t(frames) * (m_blockStride / m_blockSize) * sizeof(float));
+
+    lock.lock();
+    m_head = (m_head + 1) % (int)m_frames.size();
+    m_count--;
+    lock.unlock();
+
+    m_cond.notify_all();
+    return frames;
+}
+
+double CRenderThread::Progress() const
+{
+    if (m_scoreFrames <= 0)
+        return 0;
+
+    double progress = double(m_rendered) / double(m_scoreFrames);
+    return progress < 1 ? progress : 1;
+}
+
+//
+// Name :        CRenderThread::ThreadLoop()
+// Description : The render thread. Renders into the tail of the queue
+//               while there is room, until the score ends or we are
+//               cancelled.
+//
+
+void CRenderThread::ThreadLoop()
+{
+    m_synthesizer->Start();
+
+    int blocks = (int)m_frames.size();
+
+    while (!m_cancel)
+    {
+        int tail;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this, blocks] { return m_count < blocks || m_cancel; });
+            if (m_cancel)
+                break;
+
+            tail = (m_head + m_count) % blocks;
+        }
+
+        int frames = m_synthesizer->GenerateBlock(&m_blocks[size_t(tail) * m_blockStride], m_blockSize);
+        if (frames == 0)
+            break;
+
+        m_rendered += frames;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_frames[tail] = frames;
+            m_count++;
+        }
+
+        m_cond.notify_all();
+
+        // A short block is the end of the score
+        if (frames < m_blockSize)
+            break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finished = true;
+    }
+
+    m_cond.notify_all();
+}
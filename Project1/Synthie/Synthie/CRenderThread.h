@@ -0,0 +1,69 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CSynthesizer;
+
+//! Renders a synthesizer on its own thread into a queue of blocks
+/*! The render thread keeps up to a queue's worth of blocks ahead of
+ *  whoever calls Pop(), so a slow output or a user interface never
+ *  holds up synthesis, and synthesis never holds up the interface.
+ *  Cancel() is an atomic flag the render thread checks once per block.
+ *  FramesRendered() and Progress() can be read from any thread while
+ *  the render runs.
+ */
+class CRenderThread
+{
+public:
+    CRenderThread();
+    virtual ~CRenderThread();
+
+    //! Start rendering synthesizer from the beginning of its score
+    /*! The synthesizer belongs to the render thread until Stop(). */
+    void Start(CSynthesizer* synthesizer, int queueBlocks = 16);
+
+    //! Ask the render thread to stop after the block it is on
+    void Cancel() { m_cancel = true; }
+
+    //! Cancel and wait for the render thread to finish
+    void Stop();
+
+    //! Take the next block, waiting at most timeoutMs milliseconds (-1 waits forever)
+    /*! out must hold BlockSize() frames. Returns the frames in the
+     *  block, 0 once the render has ended, or -1 if the wait timed out. */
+    int Pop(float* out, int timeoutMs = -1);
+
+    //! Frames in a full block
+    int BlockSize() const { return m_blockSize; }
+
+    bool IsCancelled() const { return m_cancel; }
+
+    //! Frames rendered so far
+    long long FramesRendered() const { return m_rendered; }
+
+    //! How far through the score the render is, 0 to 1
+    double Progress() const;
+
+private:
+    void ThreadLoop();
+
+    CSynthesizer* m_synthesizer;
+    int m_blockSize;
+    int m_blockStride;          //!< Samples in one block of the queue
+    long long m_scoreFrames;    //!< Length of the score, for Progress()
+
+    std::vector<float> m_blocks;    //!< The queue's blocks, one after another
+    std::vector<int> m_frames;      //!< Frames in each block of the queue
+    int m_head;                 //!< Next block to pop
+    int m_count;                //!< Blocks waiting to be popped
+    bool m_finished;            //!< The render thread has ended
+
+    std::thread m_thread;
+    std::mutex  m_mutex;
+    std::condition_variable m_cond;     //!< A block was pushed or popped
+    std::atomic<bool> m_cancel;
+    std::atomic<long long> m_rendered;
+};
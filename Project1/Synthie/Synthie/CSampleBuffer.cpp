@@ -0,0 +1,74 @@
+#include "pch.h"
+#include "CSampleBuffer.h"
+#include "audio/WaveMap.h"
+#include "audio/SampleConvert.h"
+
+CSampleBuffer::CSampleBuffer()
+{
+    m_numChannels = 0;
+    m_numFrames = 0;
+    m_headFrames = 0;
+    m_sampleRate = 44100;
+}
+
+CSampleBufferPtr CSampleBuffer::Load(LPCTSTR filename, size_t streamBytes, int headFrames)
+{
+    CWaveMap wave(filename);
+    if (wave.fail())
+        return NULL;
+
+    bool stream = streamBytes > 0 && wave.DataSize() > streamBytes && headFrames > 0;
+
+    std::shared_ptr<CSampleBuffer> buffer = std::make_shared<CSampleBuffer>();
+    buffer->m_path = filename;
+    if (!buffer->Read(wave, stream ? headFrames : 0))
+        return NULL;
+
+    return buffer;
+}
+
+//
+// Name :        CSampleBuffer::Read()
+// Description : Convert the frames of a mapped wave to float,
+//               de-interleaving the channels as we go. Only the
+//               first maxFrames frames are read if it is not zero.
+// Returns :     true if successful.
+//
+
+bool CSampleBuffer::Read(const CWaveMap& wave, int maxFrames)
+{
+    m_numChannels = wave.NumChannels();
+    m_numFrames = wave.NumSampleFrames();
+    m_headFrames = maxFrames > 0 && maxFrames < m_numFrames ? maxFrames : m_numFrames;
+    m_sampleRate = wave.SampleRate();
+
+    if (m_numChannels < 1 || wave.fail())
+        return false;
+
+    m_samples.assign(size_t(m_numChannels) * m_headFrames, 0.f);
+
+    // Convert a run of interleaved frames at a time, then spread
+    // the run out across the channels.
+    const int runFrames = 4096;
+    std::vector<float> run(size_t(runFrames) * m_numChannels);
+    size_t frameBytes = size_t(m_numChannels) * wave.BytesPerSample();
+    bool isFloat = wave.SampleFormat() == CWaveMap::Float;
+
+    for (int start = 0; start < m_headFrames; start += runFrames)
+    {
+        int n = m_headFrames - start < runFrames ? m_headFrames - start : runFrames;
+
+        if (!ConvertSamples(&run[0], wave.Data() + start * frameBytes, size_t(n) * m_numChannels,
+            wave.BytesPerSample(), isFloat))
+            return false;
+
+        for (int c = 0; c < m_numChannels; c++)
+        {
+            float* dst = &m_samples[c * m_headFrames + start];
+            for (int i = 0; i < n; i++)
+                dst[i] = run[i * m_numChannels + c];
+        }
+    }
+
+    return true;
+}
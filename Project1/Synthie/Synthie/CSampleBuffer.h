@@ -0,0 +1,58 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+class CWaveMap;
+class CSampleBuffer;
+
+//! Shared, read-only reference to a loaded sample
+typedef std::shared_ptr<const CSampleBuffer> CSampleBufferPtr;
+
+//! A wave held in memory as float samples, one array per channel
+/*! A sample buffer is filled once, when it is loaded, and never changes
+ *  after that. It is handed around as a CSampleBufferPtr, so any number
+ *  of voices on any thread can play it at the same time, each keeping
+ *  its own position, and it lives as long as the last voice using it.
+ *
+ *  A wave too big to hold in memory is streamed: only its first
+ *  HeadFrames() frames are loaded, and CSampleStreamer reads the rest
+ *  from Path() as voices play it.
+ */
+class CSampleBuffer
+{
+public:
+    CSampleBuffer();
+
+    //! Load a wave file, or return NULL if it can't be read
+    /*! If streamBytes is not zero and the wave has more sample data
+     *  than that, only the first headFrames frames are loaded. */
+    static CSampleBufferPtr Load(LPCTSTR filename, size_t streamBytes = 0, int headFrames = 0);
+
+    //! Read the frames of a mapped wave, no more than maxFrames if it is not zero
+    bool Read(const CWaveMap& wave, int maxFrames = 0);
+
+    int NumChannels() const { return m_numChannels; }
+    int NumFrames() const { return m_numFrames; }
+    double SampleRate() const { return m_sampleRate; }
+
+    //! Frames held in memory, NumFrames() unless the wave is streamed
+    int HeadFrames() const { return m_headFrames; }
+
+    //! Is only the head of the wave in memory?
+    bool IsStreamed() const { return m_headFrames < m_numFrames; }
+
+    //! The file the wave was loaded from
+    const std::wstring& Path() const { return m_path; }
+
+    //! The samples of one channel, scaled to -1 to 1, HeadFrames() of them
+    const float* Channel(int c) const { return &m_samples[c * m_headFrames]; }
+
+private:
+    int m_numChannels;
+    int m_numFrames;
+    int m_headFrames;
+    double m_sampleRate;
+    std::wstring m_path;
+    std::vector<float> m_samples;   //!< Each channel's frames, one channel after another
+};
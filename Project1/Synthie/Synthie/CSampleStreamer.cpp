@@ -0,0 +1,351 @@
+#include "pch.h"
+#include "CSampleStreamer.h"
+#include "audio/Wave.h"
+
+CStreamCursor::CStreamCursor()
+{
+    m_streamer = NULL;
+    m_ring.assign(RingFrames * 2, 0.f);
+    m_read = 0;
+    m_write = 0;
+    m_active = false;
+    m_failed = false;
+    m_available = 0;
+    m_underruns = 0;
+    m_fetch = 0;
+    m_loopStart = 0;
+    m_loopEnd = 0;
+}
+
+//
+// Name :        CStreamCursor::Read()
+// Description : Read the next frame from the ring. Called by the voice
+//               that holds the cursor, on whatever thread renders it.
+//
+
+bool CStreamCursor::Read(float* frame)
+{
+    long long read = m_read.load(std::memory_order_relaxed);
+
+    if (m_available == 0)
+    {
+        m_available = m_write.load(std::memory_order_acquire) - read;
+
+        if (m_available == 0 && m_streamer->IsBlocking() && !m_failed)
+        {
+            m_streamer->WaitFor(this);
+            m_available = m_write.load(std::memory_order_acquire) - read;
+        }
+
+        if (m_available == 0)
+        {
+            frame[0] = 0;
+            frame[1] = 0;
+            m_underruns++;
+            m_streamer->m_underruns++;
+            return false;
+        }
+    }
+
+    const float* src = &m_ring[(read & (RingFrames - 1)) * 2];
+    frame[0] = src[0];
+    frame[1] = src[1];
+
+    m_read.store(read + 1, std::memory_order_release);
+    m_available--;
+    return true;
+}
+
+
+CSampleStreamer::CSampleStreamer()
+{
+    m_pending = false;
+    m_quit = false;
+    m_held = 0;
+    m_blocking = false;
+    m_underruns = 0;
+}
+
+CSampleStreamer::~CSampleStreamer()
+{
+    Stop();
+}
+
+//
+// Name :        CSampleStreamer::Reserve()
+// Description : Allocate the cursors and their rings, and start the
+//               I/O thread if there is anything to stream.
+//
+
+void CSampleStreamer::Reserve(int voices)
+{
+    Stop();
+
+    m_cursors.clear();
+    m_free.clear();
+    m_busy.clear();
+    m_pass.clear();
+    m_held = 0;
+
+    for (int i = 0; i < voices; i++)
+    {
+        m_cursors.push_back(std::unique_ptr<CStreamCursor>(new CStreamCursor));
+        m_cursors.back()->m_streamer = this;
+        m_free.push_back(m_cursors.back().get());
+    }
+
+    m_busy.reserve(voices);
+    m_pass.reserve(voices);
+
+    if (voices > 0)
+        Start();
+}
+
+void CSampleStreamer::Start()
+{
+    m_quit = false;
+    m_pending = false;
+    m_thread = std::thread(&CSampleStreamer::ThreadLoop, this);
+}
+
+void CSampleStreamer::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+
+    m_wake.notify_all();
+    m_filled.notify_all();
+    m_thread.join();
+
+    m_files.clear();
+}
+
+//
+// Name :        CSampleStreamer::Acquire()
+// Description : Start a cursor on a wave. The ring begins with the
+//               frame after the wave's head, and wraps from loopEnd
+//               back to loopStart, both in frames of the wave.
+//
+
+CStreamCursor* CSampleStreamer::Acquire(const CSampleBufferPtr& wave, int loopStart, int loopEnd)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_free.empty())
+        return NULL;
+
+    // A free cursor is not in any pass of the I/O thread
+    CStreamCursor* cursor = m_free.back();
+    m_free.pop_back();
+
+    cursor->m_read = 0;
+    cursor->m_write = 0;
+    cursor->m_available = 0;
+    cursor->m_underruns = 0;
+    cursor->m_failed = false;
+    cursor->m_active = true;
+    cursor->m_wave = wave;
+    cursor->m_loopStart = loopStart;
+    cursor->m_loopEnd = loopEnd;
+    cursor->m_fetch = wave->HeadFrames() < loopEnd ? wave->HeadFrames() : loopStart;
+
+    m_busy.push_back(cursor);
+    m_held++;
+
+    // Get the ring filling while the voice plays its head
+    m_pending = true;
+    m_wake.notify_one();
+
+    return cursor;
+}
+
+void CSampleStreamer::ReleaseAll()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < m_busy.size(); i++)
+        m_busy[i]->Release();
+
+    m_pending = true;
+    m_wake.notify_one();
+}
+
+void CSampleStreamer::Wake()
+{
+    if (m_held == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending = true;
+    m_wake.notify_one();
+}
+
+//
+// Name :        CSampleStreamer::WaitFor()
+// Description : Wait until the I/O thread has put something in a
+//               cursor's ring, or cannot.
+//
+
+void CSampleStreamer::WaitFor(CStreamCursor* cursor)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    m_pending = true;
+    m_wake.notify_one();
+
+    m_filled.wait(lock, [this, cursor] {
+        return cursor->m_write.load(std::memory_order_acquire) > cursor->m_read.load(std::memory_order_relaxed) ||
+            cursor->m_failed || m_quit; });
+}
+
+//
+// Name :        CSampleStreamer::ThreadLoop()
+// Description : The I/O thread. Each pass reclaims the cursors voices
+//               have released and tops up the rest a chunk at a time,
+//               going round again while any ring has room.
+//
+
+void CSampleStreamer::ThreadLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    for (;;)
+    {
+        m_wake.wait(lock, [this] { return m_pending || m_quit; });
+        if (m_quit)
+            break;
+
+        m_pending = false;
+
+        int keep = 0;
+        for (size_t i = 0; i < m_busy.size(); i++)
+        {
+            CStreamCursor* cursor = m_busy[i];
+            if (cursor->m_active)
+            {
+                m_busy[keep++] = cursor;
+            }
+            else
+            {
+                cursor->m_wave.reset();
+                m_free.push_back(cursor);
+                m_held--;
+            }
+        }
+
+        m_busy.resize(keep);
+        m_pass = m_busy;
+
+        // Read from disk without holding the lock
+        lock.unlock();
+
+        bool more = false;
+        for (size_t i = 0; i < m_pass.size(); i++)
+        {
+            if (m_pass[i]->m_active && !m_pass[i]->m_failed)
+                more = Fill(m_pass[i]) || more;
+        }
+
+        // Close the files of waves nothing plays any more
+        for (auto f = m_files.begin(); f != m_files.end(); )
+        {
+            if (f->second.first.use_count() == 1)
+                f = m_files.erase(f);
+            else
+                ++f;
+        }
+
+        lock.lock();
+
+        if (more)
+            m_pending = true;
+
+        m_filled.notify_all();
+    }
+}
+
+//
+// Name :        CSampleStreamer::Fill()
+// Description : Read a chunk of frames into a cursor's ring if it has
+//               room for one.
+// Returns :     true if there is room for another chunk.
+//
+
+bool CSampleStreamer::Fill(CStreamCursor* cursor)
+{
+    long long write = cursor->m_write.load(std::memory_order_relaxed);
+    long long space = CStreamCursor::RingFrames - (write - cursor->m_read.load(std::memory_order_acquire));
+    if (space < ChunkFrames)
+        return false;
+
+    CWaveIn* file = File(cursor->m_wave);
+    if (file == NULL)
+    {
+        cursor->m_failed = true;
+        return false;
+    }
+
+    int channels = file->NumChannels();
+    float* ring = &cursor->m_ring[0];
+
+    for (int n = ChunkFrames; n > 0; )
+    {
+        int run = cursor->m_loopEnd - cursor->m_fetch;
+        if (run > n)
+            run = n;
+
+        // Other cursors on the same wave may have moved the file
+        if (file->CurFrame() != cursor->m_fetch)
+            file->SeekFrame(cursor->m_fetch);
+
+        m_chunk.resize(size_t(run) * channels);
+        int got = file->ReadFrames(&m_chunk[0], run);
+        if (got <= 0)
+        {
+            cursor->m_failed = true;
+            break;
+        }
+
+        // Mono waves play on both channels
+        for (int i = 0; i < got; i++)
+        {
+            float* dst = ring + ((write + i) & (CStreamCursor::RingFrames - 1)) * 2;
+            dst[0] = m_chunk[i * channels];
+            dst[1] = channels > 1 ? m_chunk[i * channels + 1] : dst[0];
+        }
+
+        write += got;
+        n -= got;
+        cursor->m_fetch += got;
+        if (cursor->m_fetch >= cursor->m_loopEnd)
+            cursor->m_fetch = cursor->m_loopStart;
+    }
+
+    cursor->m_write.store(write, std::memory_order_release);
+    return space - ChunkFrames >= ChunkFrames;
+}
+
+//
+// The open file for a streamed wave, or NULL if it can't be read
+//
+
+CWaveIn* CSampleStreamer::File(const CSampleBufferPtr& wave)
+{
+    auto f = m_files.find(wave.get());
+    if (f == m_files.end())
+    {
+        // A file that won't open is remembered as NULL
+        std::unique_ptr<CWaveIn> file(new CWaveIn(wave->Path().c_str()));
+        if (file->fail())
+            file.reset();
+
+        f = m_files.insert(std::make_pair(wave.get(), std::make_pair(wave, std::move(file)))).first;
+    }
+
+    return f->second.second.get();
+}
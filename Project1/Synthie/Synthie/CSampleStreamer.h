@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CSampleBuffer.h"
+
+class CWaveIn;
+class CSampleStreamer;
+
+//! One voice's view of a streamed wave
+/*! A cursor is a ring of stereo frames that the streamer's I/O thread
+ *  fills from disk ahead of the voice, in the order the voice will
+ *  play them: from the end of the wave's resident head up to the loop
+ *  end, then round the loop again. The voice is the only reader and
+ *  the I/O thread the only writer, so the ring needs no lock.
+ */
+class CStreamCursor
+{
+public:
+    //! Frames the ring holds
+    static const int RingFrames = 32768;
+
+    //! Read the next stereo frame into frame
+    /*! Returns false, with a silent frame, if the I/O thread has not
+     *  kept up. A blocking streamer waits for the frame instead. */
+    bool Read(float* frame);
+
+    //! Hand the cursor back to the streamer. The voice must not use it again.
+    void Release() { m_active = false; }
+
+    //! Frames this cursor could not supply in time
+    long long Underruns() const { return m_underruns; }
+
+private:
+    friend class CSampleStreamer;
+
+    CStreamCursor();
+
+    CSampleStreamer* m_streamer;
+    std::vector<float> m_ring;          //!< RingFrames stereo frames
+    std::atomic<long long> m_read;      //!< Frames the voice has read
+    std::atomic<long long> m_write;     //!< Frames the I/O thread has written
+    std::atomic<bool> m_active;         //!< Still held by a voice?
+    std::atomic<bool> m_failed;         //!< The file could not be read
+    long long m_available;              //!< Frames the voice knows it can read
+    long long m_underruns;
+
+    // Used by the I/O thread only
+    CSampleBufferPtr m_wave;
+    int m_fetch;                //!< Next frame of the wave to fetch
+    int m_loopStart;
+    int m_loopEnd;
+};
+
+//! Streams the tails of large waves from disk for the voices playing them
+/*! Waves too big to hold in memory are loaded with only their head
+ *  resident (see CSampleBuffer::Load), so a voice can start at once.
+ *  A voice that plays past the head takes a cursor, and a background
+ *  I/O thread keeps every cursor's ring topped up from the wave file.
+ *
+ *  The cursors are allocated by Reserve(), so starting a voice never
+ *  allocates. Acquire() is called where notes start; Release() and
+ *  reading are lock free and safe from any render thread.
+ */
+class CSampleStreamer
+{
+public:
+    CSampleStreamer();
+    virtual ~CSampleStreamer();
+
+    //! Allocate cursors for up to voices streaming voices at once
+    void Reserve(int voices);
+
+    //! Take a cursor that plays wave from its head onward, or NULL if none is free
+    CStreamCursor* Acquire(const CSampleBufferPtr& wave, int loopStart, int loopEnd);
+
+    //! Take back every cursor, as when all voices are released
+    void ReleaseAll();
+
+    //! Let the I/O thread know the voices have been reading
+    void Wake();
+
+    //! Should a cursor that runs dry wait for the disk? (offline rendering)
+    void SetBlocking(bool blocking) { m_blocking = blocking; }
+    bool IsBlocking() const { return m_blocking; }
+
+    //! Frames all cursors have failed to supply in time
+    long long Underruns() const { return m_underruns; }
+
+private:
+    friend class CStreamCursor;
+
+    void Start();
+    void Stop();
+    void ThreadLoop();
+    bool Fill(CStreamCursor* cursor);
+    CWaveIn* File(const CSampleBufferPtr& wave);
+    void WaitFor(CStreamCursor* cursor);
+
+    //! Frames the I/O thread reads for a cursor at a time
+    static const int ChunkFrames = 4096;
+
+    std::vector<std::unique_ptr<CStreamCursor> > m_cursors;
+    std::vector<CStreamCursor*> m_free;     //!< Cursors no voice holds
+    std::vector<CStreamCursor*> m_busy;     //!< Cursors held or not yet reclaimed
+    std::vector<CStreamCursor*> m_pass;     //!< The I/O thread's copy of m_busy
+
+    //! Open wave files, used by the I/O thread only
+    std::map<const CSampleBuffer*, std::pair<CSampleBufferPtr, std::unique_ptr<CWaveIn> > > m_files;
+    std::vector<float> m_chunk;             //!< Interleaved frames read from a file
+
+    std::thread m_thread;
+    std::mutex  m_mutex;
+    std::condition_variable m_wake;         //!< Voices have read, or we are quitting
+    std::condition_variable m_filled;       //!< The I/O thread has made a pass
+    bool        m_pending;                  //!< Wake() since the last pass
+    bool        m_quit;
+    std::atomic<int> m_held;                //!< Cursors handed out
+    std::atomic<bool> m_blocking;
+    std::atomic<long long> m_underruns;
+};
@@ -0,0 +1,350 @@
+#include "pch.h"
+#include "CScoreBin.h"
+#include "Utf8.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#ifdef SYNTHIE_HEADLESS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char Magic[8] = { 'S', 'Y', 'N', 'S', 'C', 'O', 'R', 'E' };
+
+// Sections start on a multiple of this, which suits every record
+const size_t SectionAlign = 8;
+
+static size_t AlignUp(size_t offset)
+{
+    return (offset + SectionAlign - 1) & ~(SectionAlign - 1);
+}
+
+CScoreBin::CScoreBin()
+{
+    m_file = NULL;
+    m_fileSize = 0;
+
+#ifdef SYNTHIE_HEADLESS
+    m_fd = -1;
+#else
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = NULL;
+#endif
+
+    m_header = NULL;
+    m_tempos = NULL;
+    m_instruments = NULL;
+    m_waves = NULL;
+    m_notes = NULL;
+    m_strings = NULL;
+}
+
+CScoreBin::~CScoreBin()
+{
+    Close();
+}
+
+//
+// Name :        CScoreBin::Open()
+// Description : Map the whole file read only and check that every
+//               section lies inside it.
+//
+
+bool CScoreBin::Open(LPCTSTR filename, wstring& error)
+{
+    Close();
+
+    size_t fileSize = 0;
+
+#ifdef SYNTHIE_HEADLESS
+    m_fd = ::open(WideToUtf8(filename).c_str(), O_RDONLY);
+    if (m_fd < 0)
+    {
+        error = wstring(L"Unable to open ") + filename;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(m_fd, &st) == 0)
+        fileSize = size_t(st.st_size);
+
+    if (fileSize > 0)
+    {
+        void* view = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, m_fd, 0);
+        if (view != MAP_FAILED)
+            m_file = (const unsigned char*)view;
+    }
+#else
+    m_hFile = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        error = wstring(L"Unable to open ") + filename;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(m_hFile, &size))
+        fileSize = size_t(size.QuadPart);
+
+    if (fileSize > 0)
+    {
+        m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_hMapping != NULL)
+            m_file = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#endif
+
+    m_fileSize = fileSize;
+
+    if (m_file == NULL || !Check(fileSize, error))
+    {
+        if (m_file == NULL)
+            error = wstring(L"Unable to map ") + filename;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void CScoreBin::Close()
+{
+#ifdef SYNTHIE_HEADLESS
+    if (m_file != NULL)
+        munmap((void*)m_file, m_fileSize);
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_fd = -1;
+#else
+    if (m_file != NULL)
+        UnmapViewOfFile(m_file);
+    if (m_hMapping != NULL)
+        CloseHandle(m_hMapping);
+    if (m_hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(m_hFile);
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = NULL;
+#endif
+
+    m_file = NULL;
+    m_fileSize = 0;
+    m_header = NULL;
+    m_tempos = NULL;
+    m_instruments = NULL;
+    m_waves = NULL;
+    m_notes = NULL;
+    m_strings = NULL;
+}
+
+//
+// Name :        CScoreBin::Check()
+// Description : Check the header and that each table fits in the file,
+//               then point the tables into the mapping.  The notes
+//               themselves are not read here.
+//
+
+bool CScoreBin::Check(size_t fileSize, wstring& error)
+{
+    if (fileSize < sizeof(Header) || memcmp(m_file, Magic, sizeof(Magic)) != 0)
+    {
+        error = L"Not a compiled score file";
+        return false;
+    }
+
+    const Header* header = (const Header*)m_file;
+    if (header->version != Version)
+    {
+        error = L"Compiled score file is from another version of the synthesizer";
+        return false;
+    }
+
+    if (header->byteOrder != ByteOrder || header->noteSize != sizeof(CNote))
+    {
+        error = L"Compiled score file was written on an incompatible machine";
+        return false;
+    }
+
+    // Each section must be aligned and lie inside the file
+    struct Section { uint64_t offset; uint64_t count; size_t size; };
+    Section sections[] = {
+        { header->tempoOffset, header->numTempos, sizeof(Tempo) },
+        { header->instrumentOffset, header->numInstruments, sizeof(Instrument) },
+        { header->waveOffset, header->numWaves, sizeof(Wave) },
+        { header->noteOffset, header->numNotes, sizeof(CNote) },
+        { header->stringOffset, header->stringSize, 1 },
+    };
+
+    for (const Section& section : sections)
+    {
+        if (section.offset % SectionAlign != 0 || section.offset > fileSize ||
+            section.count > (fileSize - section.offset) / section.size)
+        {
+            error = L"Compiled score file is damaged";
+            return false;
+        }
+    }
+
+    if (header->numTempos != 1)
+    {
+        error = L"Compiled score file has tempo changes, which are not supported";
+        return false;
+    }
+
+    // Every note's start is worked out from the tempo
+    const Tempo* tempo = (const Tempo*)(m_file + header->tempoOffset);
+    if (!(tempo->bpm > 0) || !isfinite(tempo->bpm) || tempo->beatsPerMeasure == 0 ||
+        !(header->polyphonyRate > 0) || !isfinite(header->polyphonyRate))
+    {
+        error = L"Compiled score file is damaged";
+        return false;
+    }
+
+    m_header = header;
+    m_tempos = tempo;
+    m_instruments = (const Instrument*)(m_file + header->instrumentOffset);
+    m_waves = (const Wave*)(m_file + header->waveOffset);
+    m_notes = (const CNote*)(m_file + header->noteOffset);
+    m_strings = (const char*)(m_file + header->stringOffset);
+
+    // The voice pools are sized by the peaks, which no more notes than
+    // there are can reach
+    for (uint32_t i = 0; i < header->numInstruments; i++)
+    {
+        if (uint64_t(m_instruments[i].name) + m_instruments[i].nameLength > header->stringSize ||
+            m_instruments[i].peakPolyphony < 0 || uint64_t(m_instruments[i].peakPolyphony) > header->numNotes)
+        {
+            error = L"Compiled score file is damaged";
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->numWaves; i++)
+    {
+        if (uint64_t(m_waves[i].path) + m_waves[i].pathLength > header->stringSize)
+        {
+            error = L"Compiled score file is damaged";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+wstring CScoreBin::String(uint32_t offset, uint32_t length) const
+{
+    return Utf8ToWide(m_strings + offset, length);
+}
+
+wstring CScoreBin::InstrumentName(int i) const
+{
+    return String(m_instruments[i].name, m_instruments[i].nameLength);
+}
+
+wstring CScoreBin::WavePath(int i) const
+{
+    return String(m_waves[i].path, m_waves[i].pathLength);
+}
+
+//
+// Name :        CScoreBin::Write()
+// Description : Lay out the sections, header first and the strings
+//               last, and write them in one pass.
+//
+
+bool CScoreBin::Write(LPCTSTR filename, const Tempo& tempo,
+    const vector<wstring>& instruments, const vector<int>& peaks,
+    double polyphonyRate, const CNote* notes, size_t numNotes,
+    const vector<wstring>& waves, wstring& error)
+{
+    string strings;
+    vector<Instrument> instrumentTable(instruments.size());
+    for (size_t i = 0; i < instruments.size(); i++)
+    {
+        string name = WideToUtf8(instruments[i].c_str());
+        instrumentTable[i].name = uint32_t(strings.size());
+        instrumentTable[i].nameLength = uint32_t(name.size());
+        instrumentTable[i].peakPolyphony = i < peaks.size() ? peaks[i] : 0;
+        instrumentTable[i].reserved = 0;
+        strings += name;
+    }
+
+    vector<Wave> waveTable(waves.size());
+    for (size_t i = 0; i < waves.size(); i++)
+    {
+        string path = WideToUtf8(waves[i].c_str());
+        waveTable[i].path = uint32_t(strings.size());
+        waveTable[i].pathLength = uint32_t(path.size());
+        strings += path;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = Version;
+    header.byteOrder = ByteOrder;
+    header.noteSize = sizeof(CNote);
+    header.numTempos = 1;
+    header.numInstruments = uint32_t(instrumentTable.size());
+    header.numWaves = uint32_t(waveTable.size());
+    header.numNotes = numNotes;
+    header.polyphonyRate = polyphonyRate;
+
+    header.tempoOffset = AlignUp(sizeof(Header));
+    header.instrumentOffset = AlignUp(size_t(header.tempoOffset) + sizeof(Tempo));
+    header.waveOffset = AlignUp(size_t(header.instrumentOffset) + instrumentTable.size() * sizeof(Instrument));
+    header.noteOffset = AlignUp(size_t(header.waveOffset) + waveTable.size() * sizeof(Wave));
+    header.stringOffset = AlignUp(size_t(header.noteOffset) + numNotes * sizeof(CNote));
+    header.stringSize = strings.size();
+
+#ifdef SYNTHIE_HEADLESS
+    ofstream file(WideToUtf8(filename).c_str(), ios::binary);
+#else
+    ofstream file(filename, ios::binary);
+#endif
+
+    if (!file)
+    {
+        error = wstring(L"Unable to create ") + filename;
+        return false;
+    }
+
+    // Zeros up to the start of the next section
+    auto pad = [&file](uint64_t offset)
+    {
+        static const char zeros[SectionAlign] = { 0 };
+        file.write(zeros, streamsize(offset - uint64_t(file.tellp())));
+    };
+
+    Tempo tempoRecord = tempo;
+    tempoRecord.reserved = 0;
+
+    file.write((const char*)&header, sizeof(header));
+    pad(header.tempoOffset);
+    file.write((const char*)&tempoRecord, sizeof(tempoRecord));
+    pad(header.instrumentOffset);
+    if (!instrumentTable.empty())
+        file.write((const char*)&instrumentTable[0], instrumentTable.size() * sizeof(Instrument));
+    pad(header.waveOffset);
+    if (!waveTable.empty())
+        file.write((const char*)&waveTable[0], waveTable.size() * sizeof(Wave));
+    pad(header.noteOffset);
+    if (numNotes > 0)
+        file.write((const char*)notes, numNotes * sizeof(CNote));
+    pad(header.stringOffset);
+    file.write(strings.data(), strings.size());
+
+    file.close();
+    if (!file)
+    {
+        error = wstring(L"Unable to write ") + filename;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "CNote.h"
+
+//! A compiled score, memory mapped from a .scorebin file
+/*! A .scorebin holds everything CSynthesizer takes from a .score, laid
+ *  out so it can be used where it lies in memory:
+ *
+ *  - Header: where each of the sections below is, and how big
+ *  - Tempo map: one Tempo for each tempo of the score
+ *  - Instrument table: the instrument type each note's instrument id
+ *    stands for, and the most of its notes that play at once
+ *  - Wave table: the path of each wavetable wave, relative to the file
+ *  - Notes: the CNote of every note, sorted by start time
+ *  - Strings: UTF-8 names and paths the tables point into
+ *
+ *  Notes are CNote itself, so the synthesizer plays them straight from
+ *  the mapping. Files are written in the byte order and CNote layout
+ *  of the machine that writes them, and Open() refuses any other.
+ */
+class CScoreBin
+{
+public:
+    //! Start of the file
+    struct Header
+    {
+        char     magic[8];          //!< "SYNSCORE"
+        uint32_t version;
+        uint32_t byteOrder;         //!< ByteOrder, as the writer stored it
+        uint32_t noteSize;          //!< sizeof(CNote) for the writer
+        uint32_t numTempos;
+        uint32_t numInstruments;
+        uint32_t numWaves;
+        uint64_t numNotes;
+        double   polyphonyRate;     //!< Sample rate the peak polyphony was worked out for
+        uint64_t tempoOffset;
+        uint64_t instrumentOffset;
+        uint64_t waveOffset;
+        uint64_t noteOffset;
+        uint64_t stringOffset;
+        uint64_t stringSize;
+    };
+
+    //! The tempo from a beat of the score on
+    struct Tempo
+    {
+        double   beat;              //!< First beat at this tempo, from zero
+        double   bpm;               //!< Beats per minute
+        uint32_t beatsPerMeasure;
+        uint32_t reserved;
+    };
+
+    //! An instrument id used by the notes
+    struct Instrument
+    {
+        uint32_t name;              //!< Offset of the type name in the strings
+        uint32_t nameLength;
+        int32_t  peakPolyphony;     //!< Most notes playing at once
+        uint32_t reserved;
+    };
+
+    //! A wavetable wave
+    struct Wave
+    {
+        uint32_t path;              //!< Offset of the path in the strings
+        uint32_t pathLength;
+    };
+
+    static const uint32_t Version = 1;
+    static const uint32_t ByteOrder = 0x01020304;
+
+    CScoreBin();
+    virtual ~CScoreBin();
+
+    CScoreBin(const CScoreBin&) = delete;
+    CScoreBin& operator=(const CScoreBin&) = delete;
+
+    //! Map a .scorebin file and check it
+    /*! Returns false with a message in error if it can't be used */
+    bool Open(LPCTSTR filename, std::wstring& error);
+
+    //! Release the mapping. Notes() is no longer valid.
+    void Close();
+
+    bool IsOpen() const { return m_header != NULL; }
+
+    int NumTempos() const { return int(m_header->numTempos); }
+    const Tempo& GetTempo(int i) const { return m_tempos[i]; }
+
+    int NumInstruments() const { return int(m_header->numInstruments); }
+
+    //! The instrument type that notes with instrument id i play
+    std::wstring InstrumentName(int i) const;
+
+    //! Most notes of instrument id i that play at once
+    int PeakPolyphony(int i) const { return m_instruments[i].peakPolyphony; }
+
+    //! The sample rate PeakPolyphony() was worked out for; it holds at higher rates
+    double PolyphonyRate() const { return m_header->polyphonyRate; }
+
+    size_t NumNotes() const { return size_t(m_header->numNotes); }
+
+    //! The notes, sorted by start time, in the mapping
+    const CNote* Notes() const { return m_notes; }
+
+    int NumWaves() const { return int(m_header->numWaves); }
+    std::wstring WavePath(int i) const;
+
+    //! Write a .scorebin file
+    /*! instruments and peaks are indexed by the notes' instrument ids.
+     *  Returns false with a message in error if it can't be written. */
+    static bool Write(LPCTSTR filename, const Tempo& tempo,
+        const std::vector<std::wstring>& instruments, const std::vector<int>& peaks,
+        double polyphonyRate, const CNote* notes, size_t numNotes,
+        const std::vector<std::wstring>& waves, std::wstring& error);
+
+private:
+    bool Check(size_t fileSize, std::wstring& error);
+    std::wstring String(uint32_t offset, uint32_t length) const;
+
+    const unsigned char* m_file;    //!< Start of the mapping
+    size_t m_fileSize;
+
+#ifdef SYNTHIE_HEADLESS
+    int m_fd;
+#else
+    HANDLE m_hFile;
+    HANDLE m_hMapping;
+#endif
+
+    const Header*     m_header;
+    const Tempo*      m_tempos;
+    const Instrument* m_instruments;
+    const Wave*       m_waves;
+    const CNote*      m_notes;
+    const char*       m_strings;
+};
@@ -1,6 +1,13 @@
 #include "pch.h"
 #include "CSineWave.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SYNTHIE_SSE2
+#endif
+
 CSineWave::CSineWave()
 {
 	m_phase = 0;
@@ -21,4 +28,119 @@ bool CSineWave::Generate()
     m_phase += m_freq * GetSamplePeriod();
 
     return true;
-}
\ No newline at end of file
+}
+
+//
+// Name :        SineBlock()
+// Description : Fill out with frames stereo frames of amp * sin(2 pi x),
+//               where x starts at phase and advances by step each frame.
+//
+//               Rather than calling sin() for every sample this keeps
+//               one phasor e^(i 2 pi x) per SIMD lane, for consecutive
+//               frames, and rotates them all by Lanes frames at a time
+//               with a complex multiply.  The phasors are computed
+//               exactly (in double) at the start of every block, so the
+//               float rounding of the rotation only builds up over one
+//               block.  Over the largest block of 1024 frames the error
+//               stays below 1e-5 of the amplitude, which is under half a
+//               16 bit LSB at full scale.
+//
+
+#if defined(__AVX2__)
+const int Lanes = 8;
+#else
+const int Lanes = 4;
+#endif
+
+static void SineBlock(float* out, int frames, double phase, double step, double amp)
+{
+    // Phasors for frames 0 .. Lanes-1 and the rotation by Lanes frames
+    alignas(32) float re[Lanes];
+    alignas(32) float im[Lanes];
+    for (int k = 0; k < Lanes; k++)
+    {
+        double angle = 2 * PI * (phase + k * step);
+        re[k] = float(amp * cos(angle));
+        im[k] = float(amp * sin(angle));
+    }
+
+    float rotRe = float(cos(2 * PI * Lanes * step));
+    float rotIm = float(sin(2 * PI * Lanes * step));
+
+    int i = 0;
+
+#if defined(__AVX2__)
+    __m256 zr = _mm256_load_ps(re);
+    __m256 zi = _mm256_load_ps(im);
+    __m256 rr = _mm256_set1_ps(rotRe);
+    __m256 ri = _mm256_set1_ps(rotIm);
+
+    for (; i + Lanes <= frames; i += Lanes)
+    {
+        // Duplicate each sample into both channels
+        __m256 lo = _mm256_unpacklo_ps(zi, zi);
+        __m256 hi = _mm256_unpackhi_ps(zi, zi);
+        _mm256_storeu_ps(out + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+
+        __m256 nr = _mm256_fmsub_ps(zr, rr, _mm256_mul_ps(zi, ri));
+        zi = _mm256_fmadd_ps(zr, ri, _mm256_mul_ps(zi, rr));
+        zr = nr;
+    }
+
+    _mm256_store_ps(re, zr);
+    _mm256_store_ps(im, zi);
+#elif defined(SYNTHIE_SSE2)
+    __m128 zr = _mm_load_ps(re);
+    __m128 zi = _mm_load_ps(im);
+    __m128 rr = _mm_set1_ps(rotRe);
+    __m128 ri = _mm_set1_ps(rotIm);
+
+    for (; i + Lanes <= frames; i += Lanes)
+    {
+        // Duplicate each sample into both channels
+        _mm_storeu_ps(out + i * 2, _mm_unpacklo_ps(zi, zi));
+        _mm_storeu_ps(out + i * 2 + 4, _mm_unpackhi_ps(zi, zi));
+
+        __m128 nr = _mm_sub_ps(_mm_mul_ps(zr, rr), _mm_mul_ps(zi, ri));
+        zi = _mm_add_ps(_mm_mul_ps(zr, ri), _mm_mul_ps(zi, rr));
+        zr = nr;
+    }
+
+    _mm_store_ps(re, zr);
+    _mm_store_ps(im, zi);
+#else
+    for (; i + Lanes <= frames; i += Lanes)
+    {
+        for (int k = 0; k < Lanes; k++)
+        {
+            out[(i + k) * 2] = im[k];
+            out[(i + k) * 2 + 1] = im[k];
+
+            float nr = re[k] * rotRe - im[k] * rotIm;
+            im[k] = re[k] * rotIm + im[k] * rotRe;
+            re[k] = nr;
+        }
+    }
+#endif
+
+    // The last partial run of frames
+    for (int k = 0; i < frames; i++, k++)
+    {
+        out[i * 2] = im[k];
+        out[i * 2 + 1] = im[k];
+    }
+}
+
+bool CSineWave::GenerateBlock(float* out, int frames)
+{
+    double step = m_freq * GetSamplePeriod();
+
+    SineBlock(out, frames, m_phase, step, m_amp);
+
+    // Keep the phase small so we do not lose precision on long notes
+    m_phase += frames * step;
+    m_phase -= floor(m_phase);
+
+    return true;
+}
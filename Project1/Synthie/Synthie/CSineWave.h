@@ -10,6 +10,9 @@ public:
     //! Generate one frame of audio
     virtual bool Generate();
 
+    //! Generate a block of audio frames
+    virtual bool GenerateBlock(float* out, int frames);
+
     //! Set the sine wave frequency
     void SetFreq(double f) { m_freq = f; }
 
@@ -1,13 +1,44 @@
 #include "pch.h"
 #include "CSynthesizer.h"
-#include "xmlhelp.h"
 #include <algorithm>
-#include "audio/wave.h"
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include "audio/Wave.h"
+#include "Utf8.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SYNTHIE_SSE2
+#endif
+
+// Voices are rendered in runs of at least this many, each its own task
+const int MinVoicesPerTask = 4;
+
+// The most tasks a block is cut into, whatever the number of threads,
+// which leaves several for each of 8 threads to steal between
+const int MaxTasks = 32;
+
+// Limits on the number of frames rendered per block
+const int MinBlockSize = 64;
+const int MaxBlockSize = 1024;
+
+// Frames of a streamed wave held in memory, about 1.5 seconds,
+// which the disk has to get ahead of
+const int StreamHeadFrames = 65536;
+
+// Seconds a stolen voice takes to fade out
+const double StealFadeTime = 0.005;
+
+// A voice quieter than this (-100 dB) for this long is done
+const double DefaultSilenceThreshold = 0.00001;
+const double DefaultSilenceTime = 0.1;
+
+// Frames between updates of the render stats snapshot
+const int StatsInterval = 4096;
 
 CSynthesizer::CSynthesizer()
 {
-    CoInitialize(NULL);
-
 	m_channels = 2;
 	m_sampleRate = 44100.;
 	m_samplePeriod = 1 / m_sampleRate;
@@ -15,59 +46,282 @@ CSynthesizer::CSynthesizer()
     m_bpm = 120;
     m_secperbeat = 60 / m_bpm;
     m_beatspermeasure = 4;
-    m_filename_cache = nullptr;
+    m_currentNote = 0;
+    m_sample = 0;
+    m_scoreFrames = 0;
+    m_score = NULL;
+    m_numNotes = 0;
+    m_peakRate = 0;
+    m_blockFrames = 0;
+    m_blockPos = 0;
+    m_streamBytes = 64 * 1024 * 1024;
+    m_maxPolyphony = 0;
+    m_stealPolicy = StealOldest;
+    m_fadeFrames = 1;
+    m_silenceThreshold = DefaultSilenceThreshold;
+    m_silenceTime = DefaultSilenceTime;
+    m_silenceFrames = 1;
+
+    m_toneId = RegisterInstrument(L"ToneInstrument", CreateVoicePool<CToneInstrument>);
+    m_wavetableId = RegisterInstrument(L"WavetableInstrument", CreateVoicePool<CWavetableInstrument>);
+
+    int threads = std::thread::hardware_concurrency();
+    m_workers.SetNumThreads(threads > 0 ? threads : 1);
+
+    SetBlockSize(256);
+    AllocateStats();
+    ResetStats();
+}
+
+void CSynthesizer::SetBlockSize(int frames)
+{
+    if (frames < MinBlockSize)
+        frames = MinBlockSize;
+    else if (frames > MaxBlockSize)
+        frames = MaxBlockSize;
+
+    m_blockSize = frames;
+    AllocateRenderBuffers();
+}
+
+int CSynthesizer::RegisterInstrument(const wchar_t* name, CInstrumentRegistry::PoolFactory factory)
+{
+    ReleaseVoices();
+
+    int id = m_registry.Register(name, factory);
+    if (id >= (int)m_pools.size())
+        m_pools.resize(id + 1);
+
+    m_pools[id].reset(m_registry.CreatePool(id));
+    m_priorities.resize(m_pools.size());
+    AllocateStats();
+    return id;
+}
+
+void CSynthesizer::SetSilence(double threshold, double seconds)
+{
+    m_silenceThreshold = threshold > 0 ? threshold : 0;
+    m_silenceTime = seconds > 0 ? seconds : 0;
+}
+
+void CSynthesizer::SetInstrumentPriority(int id, int priority)
+{
+    if (id >= 0 && id < (int)m_priorities.size())
+        m_priorities[id] = priority;
+}
+
+void CSynthesizer::SetSampleRate(double s)
+{
+    m_sampleRate = s;
+    m_samplePeriod = 1.0 / s;
+
+    // Note start frames depend on the sample rate, and so does how
+    // long a finished voice can hold on to its pool's voices
+    CompileSchedule();
+    if (m_numNotes > 0)
+        SizeVoicePools();
+}
+
+void CSynthesizer::AddWaveToTable(LPCTSTR w)
+{
+    m_waveTable.push_back(CSampleBuffer::Load(w, m_streamBytes, StreamHeadFrames));
+}
+
+bool CSynthesizer::LoadTuning(LPCTSTR filename)
+{
+    return m_tuning.LoadScala(filename, m_error);
+}
+
+void CSynthesizer::SetNumThreads(int threads)
+{
+    m_workers.SetNumThreads(threads);
+    AllocateRenderBuffers();
+    AllocateStats();
+}
+
+//
+// Size the scratch buffers used while rendering, so the
+// render loop itself never has to allocate.
+//
+
+void CSynthesizer::AllocateRenderBuffers()
+{
+    int threads = m_workers.GetNumThreads();
+    int block = m_blockSize * 2;
+
+    m_voiceBlock.resize(block);
+    m_workerVoice.resize(threads * block);
+    m_taskMix.resize(MaxTasks * block);
+    m_workers.SetMaxTasks(MaxTasks);
 }
 
 void CSynthesizer::Start(void)
 {
-    m_instruments.clear();
+    ReleaseVoices();
     m_currentNote = 0;
-    m_measure = 0;
-    m_beat = 0;
+    m_sample = 0;
     m_time = 0;
+    m_blockFrames = 0;
+    m_blockPos = 0;
+    m_silenceFrames = int(m_silenceTime * GetSampleRate());
+    ResetStats();
 }
 
 
 //! Generate one audio frame
+/*! Frames are served out of a block rendered by GenerateBlock().
+ *  Returns false when there is nothing left to play. */
 bool CSynthesizer::Generate(double* frame)
 {
-    //
-    // Phase 1: Determine if any notes need to be played.
-    //
+    if (m_blockPos >= m_blockFrames)
+    {
+        m_block.resize(m_blockSize * GetNumChannels());
+        m_blockFrames = GenerateBlock(&m_block[0], m_blockSize);
+        m_blockPos = 0;
 
-    while (m_currentNote < (int)m_notes.size())
+        if (m_blockFrames == 0)
+            return false;
+    }
+
+    const float* src = &m_block[m_blockPos * GetNumChannels()];
+    for (int c = 0; c < GetNumChannels(); c++)
     {
-        // Get a pointer to the current note
-        CNote* note = &m_notes[m_currentNote];
+        frame[c] = src[c];
+    }
 
-        // If the measure is in the future we can't play
-        // this note just yet.
-        if (note->Measure() > m_measure)
-            break;
+    m_blockPos++;
+    return true;
+}
 
-        // If this is the current measure, but the
-        // beat has not been reached, we can't play
-        // this note.
-        if (note->Measure() == m_measure && note->Beat() > m_beat)
-            break;
+//! Generate a block of audio frames
+/*! Fills out with up to frames interleaved frames of GetNumChannels()
+ *  channels. Notes start on the exact frame the schedule says, wherever
+ *  that falls within the block.
+ *  Returns the number of frames generated, which is less than frames
+ *  only when the score is done. */
+int CSynthesizer::GenerateBlock(float* out, int frames)
+{
+    int done = 0;
+
+    while (done < frames && !IsDone())
+    {
+        int n = frames - done;
+        if (n > m_blockSize)
+            n = m_blockSize;
+
+        unsigned long long dispatchStart = CycleCount();
+
+        // With nothing playing until the next note, the blocks up to it
+        // are silence and there is nothing to render
+        if (m_voices.empty() && m_noteSamples[m_currentNote] >= m_sample + n)
+        {
+            n = QuietFrames(frames - done);
+            memset(out + done * GetNumChannels(), 0, size_t(n) * GetNumChannels() * sizeof(float));
+
+            m_sample += n;
+            m_time = m_sample * GetSamplePeriod();
+            done += n;
+
+            unsigned long long cycles = CycleCount() - dispatchStart;
+            m_renderCycles += cycles;
+            m_mixCycles += cycles;
+            UpdateStats(n, 0);
+            continue;
+        }
+
+        //
+        // Phase 1: Start the notes that fall within this block.
+        //
+
+        StartNotes(n);
+        int voices = (int)m_voices.size();
+
+        //
+        // Phase 2: Play the active instruments
+        //
+
+        unsigned long long renderStart = CycleCount();
+        RenderVoices(out + done * GetNumChannels(), n);
+        unsigned long long advanceStart = CycleCount();
+
+        // Let the disk catch up on what the voices just streamed
+        m_streamer.Wake();
+
+        //
+        // Phase 3: Advance the time
+        //
+
+        m_sample += n;
+        m_time = m_sample * GetSamplePeriod();
+        done += n;
+
+        m_dispatchCycles += renderStart - dispatchStart;
+        m_renderCycles += advanceStart - renderStart;
+        m_advanceCycles += CycleCount() - advanceStart;
+        UpdateStats(n, voices);
+    }
+
+    return done;
+}
+
+//
+// How many of the next frames frames to fill with silence when nothing
+// is playing.  It is whole blocks, up to the next note, or all of them,
+// so the blocks after it start where they would have anyway.
+//
+
+int CSynthesizer::QuietFrames(int frames)
+{
+    long long quiet = m_noteSamples[m_currentNote] - m_sample;
+    long long blocks = quiet - quiet % m_blockSize;
+
+    if (blocks >= frames || frames <= m_blockSize)
+        return frames;
+
+    return int(blocks);
+}
+
+//
+// Start every note that begins within the next frames frames.
+// Each voice remembers the frame within the block it starts on.
+//
+
+void CSynthesizer::StartNotes(int frames)
+{
+    long long blockEnd = m_sample + frames;
+
+    while (m_currentNote < (int)m_numNotes && m_noteSamples[m_currentNote] < blockEnd)
+    {
+        // Get a pointer to the current note
+        const CNote* note = &m_score[m_currentNote];
+
+        // Frame within the block the note starts on
+        long long offset = m_noteSamples[m_currentNote] - m_sample;
+        if (offset < 0)
+            offset = 0;
 
         //
         // Play the note!
         //
 
-        // Create the instrument object
+        // Take an instrument object from its voice pool.  If the
+        // pool has run dry the note is dropped, as are notes for
+        // instruments we don't know and wavetable notes with no waves.
+        int id = note->Instrument();
         CInstrument* instrument = NULL;
-        if (note->Instrument() == L"ToneInstrument")
+        if (id >= 0 && id < (int)m_pools.size() && !(id == m_wavetableId && m_waveTable.empty()))
         {
-            instrument = new CToneInstrument();
+            instrument = m_pools[id]->AcquireVoice();
         }
-        else if (note->Instrument() == L"WavetableInstrument")
+
+        if (instrument != NULL && id == m_wavetableId)
         {
             // Tell instrument which wave to play
-            instrument = new CWavetableInstrument();
-            int waveIndex = ((CWaveNote*)note)->WaveIndex();
-            if (waveIndex >= m_waveTable.size()) waveIndex = 0;
-            ((CWavetableInstrument*)instrument)->SetWave(m_waveTable[waveIndex]);
+            int waveIndex = note->WaveIndex();
+            if (waveIndex < 0 || waveIndex >= (int)m_waveTable.size()) waveIndex = 0;
+            CWavetableInstrument* wavetable = static_cast<CWavetableInstrument*>(instrument);
+            wavetable->SetWave(m_waveTable[waveIndex]);
+            wavetable->SetStreamer(&m_streamer);
         }
 
         // Configure the instrument object
@@ -77,394 +331,880 @@ bool CSynthesizer::Generate(double* frame)
             instrument->SetNote(note);
             instrument->Start();
 
-            m_instruments.push_back(instrument);
+            // Make room for it if we are at the polyphony limit
+            if (m_maxPolyphony > 0)
+                StealVoice(int(offset));
+
+            Voice voice;
+            voice.instrument = instrument;
+            voice.offset = int(offset);
+            voice.type = id;
+            voice.note = m_currentNote;
+            voice.level = FLT_MAX;
+            voice.fade = 0;
+            voice.fadeStart = 0;
+            voice.rendered = false;
+            voice.sounded = false;
+            voice.silent = 0;
+            m_voices.push_back(voice);
+
+            m_stats.notesStarted++;
+            m_rateNotes++;
         }
 
         m_currentNote++;
     }
+}
 
-    //
-    // Phase 2: Clear all channels to silence 
-    //
+//
+// Name :        CSynthesizer::StealVoice()
+// Description : If the voices that are not already fading out are at
+//               the polyphony limit, pick one to make way for a note
+//               starting offset frames into the block.  A voice that
+//               has not been heard yet is dropped; any other fades out
+//               from that frame on.
+//
 
-    for (int c = 0; c < GetNumChannels(); c++)
+void CSynthesizer::StealVoice(int offset)
+{
+    int victim = -1;
+    int playing = 0;
+
+    for (int v = 0; v < (int)m_voices.size(); v++)
     {
-        frame[c] = 0;
+        const Voice& voice = m_voices[v];
+        if (voice.fade > 0)
+            continue;
+
+        playing++;
+        if (victim < 0 || StealFirst(voice, m_voices[victim]))
+            victim = v;
     }
 
-    //
-    // Phase 3: Play an active instruments
-    //
+    if (playing < m_maxPolyphony)
+        return;
 
-    //
-    // We have a list of active (playing) instruments.  We iterate over 
-    // that list.  For each instrument we call generate, then add the
-    // output to our output frame.  If an instrument is done (Generate()
-    // returns false), we remove it from the list.
-    //
+    m_stats.voicesStolen++;
 
-    for (list<CInstrument*>::iterator node = m_instruments.begin(); node != m_instruments.end(); )
+    Voice& voice = m_voices[victim];
+    if (!voice.rendered)
     {
-        // Since we may be removing an item from the list, we need to know in 
-        // advance, what is after it in the list.  We keep that node as "next"
-        list<CInstrument*>::iterator next = node;
-        next++;
+        voice.instrument->Pool()->Release(voice.instrument);
+        m_voices[victim] = m_voices.back();
+        m_voices.pop_back();
+        return;
+    }
 
-        // Get a pointer to the allocated instrument
-        CInstrument* instrument = *node;
+    m_fadeFrames = int(StealFadeTime * GetSampleRate());
+    if (m_fadeFrames < 1)
+        m_fadeFrames = 1;
 
-        // Call the generate function
-        if (instrument->Generate())
-        {
-            // If we returned true, we have a valid sample.  Add it 
-            // to the frame.
-            for (int c = 0; c < GetNumChannels(); c++)
-            {
-                frame[c] += instrument->Frame(c);
-            }
-        }
-        else
-        {
-            // If we returned false, the instrument is done.  Remove it
-            // from the list and delete it from memory.
-            m_instruments.erase(node);
-            delete instrument;
-        }
+    voice.fade = m_fadeFrames;
+    voice.fadeStart = offset;
+}
+
+//
+// Should voice a be stolen before voice b?  Whatever the policy,
+// ties go to the older voice.
+//
 
-        // Move to the next instrument in the list
-        node = next;
+bool CSynthesizer::StealFirst(const Voice& a, const Voice& b)
+{
+    switch (m_stealPolicy)
+    {
+    case StealQuietest:
+        if (a.level != b.level)
+            return a.level < b.level;
+        break;
+
+    case StealLowestPriority:
+        if (m_priorities[a.type] != m_priorities[b.type])
+            return m_priorities[a.type] < m_priorities[b.type];
+        break;
+
+    default:
+        break;
     }
 
-    //
-    // Phase 4: Advance the time and beats
-    //
+    return a.note < b.note;
+}
 
-    // Time advances by the sample period
-    m_time += GetSamplePeriod();
+//
+// Name :        CSynthesizer::CompileSchedule()
+// Description : Convert the measure and beat of every note into the
+//               frame it starts on at the current tempo and sample rate.
+//               Also works out the frame the last note ends on.
+//               The notes must already be sorted.
+//
 
-    // Beat advances by the sample period divided by the 
-    // number of seconds per beat.  The inverse of seconds
-    // per beat is beats per second.
-    m_beat += GetSamplePeriod() / m_secperbeat;
+void CSynthesizer::CompileSchedule()
+{
+    m_noteSamples.resize(m_numNotes);
+    m_scoreFrames = 0;
 
-    // When the measure is complete, we move to
-    // a new measure.  We might be a fraction into
-    // the new measure, so we subtract out rather 
-    // than just setting to zero.
-    if (m_beat > m_beatspermeasure)
+    // The instruments convert note durations at 120 bpm (see SetNote)
+    // and default to 0.1 seconds
+    const double noteSecPerBeat = 60. / 120.;
+
+    for (size_t i = 0; i < m_numNotes; i++)
     {
-        m_beat -= m_beatspermeasure;
-        m_measure++;
-    }
+        const CNote& note = m_score[i];
+        double beats = note.Measure() * m_beatspermeasure + note.Beat();
 
-    //
-    // Phase 5: Determine when we are done
-    //
+        m_noteSamples[i] = llround(beats * m_secperbeat * GetSampleRate());
 
-    // We are done when there is nothing to play.  We'll put something more 
-    // complex here later.
-    return !m_instruments.empty() || m_currentNote < (int)m_notes.size();
+        double length = note.Duration() >= 0 ? note.Duration() * noteSecPerBeat : 0.1;
+        long long end = m_noteSamples[i] + llround(length * GetSampleRate());
+        if (end > m_scoreFrames)
+            m_scoreFrames = end;
+    }
 }
 
-void CSynthesizer::Clear(void)
+//
+// Add a stereo voice block into an output block of channels channels,
+// starting offset frames into the output block
+//
+
+static void MixVoice(float* out, int channels, const float* voice, int frames, int offset = 0)
 {
-    m_instruments.clear();
-    m_notes.clear();
+    out += offset * channels;
+
+    int mixChannels = channels < 2 ? channels : 2;
+
+    for (int i = 0; i < frames; i++)
+    {
+        for (int c = 0; c < mixChannels; c++)
+        {
+            out[i * channels + c] += voice[i * 2 + c];
+        }
+    }
 }
 
-void CSynthesizer::OpenScore(CString& filename)
+//
+// Fade a stolen voice's block out over what is left of its fade,
+// starting at frame start of the block.  Returns the frames of the
+// fade still to go.
+//
+
+static int FadeOut(float* voice, int frames, int start, int fade, int length)
 {
-    Clear();
+    for (int i = start; i < frames; i++)
+    {
+        float gain = float(fade) / length;
+        voice[i * 2] *= gain;
+        voice[i * 2 + 1] *= gain;
 
-    // cache filename
-    m_filename_cache = &filename;
+        if (fade > 0)
+            fade--;
+    }
 
-    //
-    // Create an XML document
-    //
+    return fade;
+}
+
+//
+// The loudest sample of a stereo voice block
+//
 
-    CComPtr<IXMLDOMDocument>  pXMLDoc;
-    bool succeeded = SUCCEEDED(CoCreateInstance(CLSID_DOMDocument, NULL, CLSCTX_INPROC_SERVER,
-        IID_IXMLDOMDocument, (void**)&pXMLDoc));
-    if (!succeeded)
+static float Peak(const float* voice, int frames)
+{
+    int count = frames * 2;
+    int i = 0;
+    float peak = 0;
+
+#ifdef SYNTHIE_SSE2
+    // Clearing the sign bit is the absolute value
+    const __m128 sign = _mm_set1_ps(-0.f);
+    __m128 peaks = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4)
+        peaks = _mm_max_ps(peaks, _mm_andnot_ps(sign, _mm_loadu_ps(voice + i)));
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, peaks);
+    peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+
+    for (; i < count; i++)
+        peak = std::max(peak, fabsf(voice[i]));
+
+    return peak;
+}
+
+//
+// Is every sample of a stereo voice block below threshold?  Stops at
+// the first that is not, so a voice that is playing costs next to
+// nothing to check.
+//
+
+static bool IsQuiet(const float* voice, int frames, double threshold)
+{
+    float level = float(threshold);
+    for (int i = 0; i < frames * 2; i++)
     {
-        AfxMessageBox(L"Failed to create an XML document to use");
-        return;
+        if (fabsf(voice[i]) >= level)
+            return false;
     }
 
-    // Open the XML document
-    VARIANT_BOOL ok;
-    succeeded = SUCCEEDED(pXMLDoc->load(CComVariant(filename), &ok));
-    if (!succeeded || ok == VARIANT_FALSE)
+    return true;
+}
+
+//
+// Name :        CSynthesizer::RenderVoice()
+// Description : Render one voice's frames of the current block into
+//               buffer.  A stolen voice is faded out, and a voice that
+//               has been silent for long enough is retired.  clock is
+//               the cycle count the voice started at; the cycles from
+//               then to now are charged to stats, and clock is left
+//               at now.
+// Returns :     false if the voice is done after this block.
+//
+
+bool CSynthesizer::RenderVoice(Voice& voice, float* buffer, int frames,
+    CRenderStats::Instrument& stats, unsigned long long& clock)
+{
+    int count = frames - voice.offset;
+
+    bool playing = voice.instrument->GenerateBlock(buffer, count);
+
+    if (voice.fade > 0)
     {
-        AfxMessageBox(L"Failed to open XML score file");
-        return;
+        voice.fade = FadeOut(buffer, count, voice.fadeStart, voice.fade, m_fadeFrames);
+        voice.fadeStart = 0;
+        if (voice.fade == 0)
+            playing = false;
     }
 
-    //
-    // Traverse the XML document in memory!!!!
-    // Top level tag is <score>
-    //
+    if (m_stealPolicy == StealQuietest && m_maxPolyphony > 0)
+        voice.level = Peak(buffer, count);
 
-    CComPtr<IXMLDOMNode> node;
-    pXMLDoc->get_firstChild(&node);
-    for (; node != NULL; NextNode(node))
+    // A voice that has sounded and then gone quiet for long enough is
+    // retired rather than left to play silence to the end of its note.
+    // Silence before it first sounds, like a wave's lead in, is kept.
+    if (playing && m_silenceThreshold > 0)
     {
-        // Get the name of the node
-        CComBSTR nodeName;
-        node->get_nodeName(&nodeName);
+        bool quiet = IsQuiet(buffer, count, m_silenceThreshold);
+        if (!quiet)
+            voice.sounded = true;
 
-        if (nodeName == "score")
+        voice.silent = quiet && voice.sounded ? voice.silent + count : 0;
+        if (voice.silent >= m_silenceFrames)
         {
-            XmlLoadScore(node);
+            playing = false;
+            stats.retired++;
         }
     }
 
-    sort(m_notes.begin(), m_notes.end());
+    // Next block it plays from the first frame
+    voice.offset = 0;
+    voice.rendered = true;
 
-    m_filename_cache = nullptr;
+    unsigned long long now = CycleCount();
+    stats.cycles += now - clock;
+    stats.samples += count;
+    clock = now;
+
+    return playing;
 }
 
-void CSynthesizer::XmlLoadScore(IXMLDOMNode* xml)
+//
+// Name :        CSynthesizer::RenderVoices()
+// Description : Mix frames frames of every active instrument into out.
+//               The voices are cut into contiguous runs, one per task,
+//               and each task mixes its run into its own buffer.  The
+//               task buffers are then summed in task order.  How the
+//               voices are cut depends only on how many there are, so
+//               the output is the same to the bit for any number of
+//               threads; with one thread the tasks simply run in turn.
+//
+
+void CSynthesizer::RenderVoices(float* out, int frames)
 {
-    // Get a list of all attribute nodes and the
-    // length of that list
-    CComPtr<IXMLDOMNamedNodeMap> attributes;
-    xml->get_attributes(&attributes);
-    long len;
-    attributes->get_length(&len);
+    int channels = GetNumChannels();
+    int count = (int)m_voices.size();
 
-    // Loop over the list of attributes
-    for (int i = 0; i < len; i++)
+    int tasks = (count + MinVoicesPerTask - 1) / MinVoicesPerTask;
+    if (tasks > MaxTasks)
+        tasks = MaxTasks;
+
+    //
+    // Clear the output and the task buffers to silence
+    //
+
+    unsigned long long mixStart = CycleCount();
+
+    for (int i = 0; i < frames * channels; i++)
     {
-        // Get attribute i
-        CComPtr<IXMLDOMNode> attrib;
-        attributes->get_item(i, &attrib);
+        out[i] = 0;
+    }
 
-        // Get the name of the attribute
-        CComBSTR name;
-        attrib->get_nodeName(&name);
+    for (int t = 0; t < tasks; t++)
+    {
+        float* mix = &m_taskMix[t * m_blockSize * 2];
+        for (int i = 0; i < frames * 2; i++)
+            mix[i] = 0;
+    }
 
-        // Get the value of the attribute.  A CComVariant is a variable
-        // that can have any type. It loads the attribute value as a
-        // string (UNICODE), but we can then change it to an integer 
-        // (VT_I4) or double (VT_R8) using the ChangeType function 
-        // and then read its integer or double value from a member variable.
-        CComVariant value;
-        attrib->get_nodeValue(&value);
+    m_mixCycles += CycleCount() - mixStart;
 
-        if (name == L"bpm")
-        {
-            value.ChangeType(VT_R8);
-            m_bpm = value.dblVal;
-            m_secperbeat = 1 / (m_bpm / 60);
-        }
-        else if (name == L"beatspermeasure")
+    // Voices that are not safe to render off this thread are
+    // rendered here, into the buffer of the task whose run they
+    // are in, ahead of the rest of the run.
+    for (int t = 0; t < tasks; t++)
+    {
+        float* mix = &m_taskMix[t * m_blockSize * 2];
+        int end = (t + 1) * count / tasks;
+
+        for (int v = t * count / tasks; v < end; v++)
         {
-            value.ChangeType(VT_I4);
-            m_beatspermeasure = value.intVal;
+            Voice& voice = m_voices[v];
+            if (voice.instrument->IsThreadSafe())
+                continue;
+
+            int offset = voice.offset;
+            unsigned long long clock = CycleCount();
+            m_voiceDone[v] = !RenderVoice(voice, &m_voiceBlock[0], frames, m_stats.instruments[voice.type], clock);
+            MixVoice(mix, 2, &m_voiceBlock[0], frames - offset, offset);
         }
+    }
+
+    if (tasks > 0)
+    {
+        m_workers.Run(tasks, [this, tasks, frames](int task, int worker)
+            { RenderTask(task, tasks, worker, frames); });
+    }
 
+    // Deterministic reduction into the output block
+    mixStart = CycleCount();
+    for (int t = 0; t < tasks; t++)
+    {
+        MixVoice(out, channels, &m_taskMix[t * m_blockSize * 2], frames);
     }
 
+    m_mixCycles += CycleCount() - mixStart;
 
-    CComPtr<IXMLDOMNode> node;
-    xml->get_firstChild(&node);
-    for (; node != NULL; NextNode(node))
+    // Collect what the workers' voices cost
+    size_t types = m_stats.instruments.size();
+    for (size_t i = 0; i < m_workerStats.size(); i++)
     {
-        // Get the name of the node
-        CComBSTR name;
-        node->get_nodeName(&name);
-        if (name == L"instrument")
-        {
-            XmlLoadInstrument(node);
-        }
+        CRenderStats::Instrument& stats = m_stats.instruments[i % types];
+        stats.cycles += m_workerStats[i].cycles;
+        stats.samples += m_workerStats[i].samples;
+        stats.retired += m_workerStats[i].retired;
+        m_workerStats[i] = CRenderStats::Instrument();
+    }
+
+    // Return the instruments that are done to their pools, keeping
+    // the rest in order, so the runs are cut the same way next block.
+    int keep = 0;
+    for (int v = 0; v < count; v++)
+    {
+        if (m_voiceDone[v])
+            m_voices[v].instrument->Pool()->Release(m_voices[v].instrument);
+        else
+            m_voices[keep++] = m_voices[v];
     }
+
+    m_voices.resize(keep);
 }
 
-void CSynthesizer::XmlLoadInstrument(IXMLDOMNode* xml)
+//
+// Render one task's run of voices into its mix buffer.
+// Called on a worker thread, or the caller's with one thread.
+//
+
+void CSynthesizer::RenderTask(int task, int tasks, int worker, int frames)
 {
-    wstring instrument = L"";
+    int count = (int)m_voices.size();
+    int begin = task * count / tasks;
+    int end = (task + 1) * count / tasks;
 
-    // Get a list of all attribute nodes and the
-    // length of that list
-    CComPtr<IXMLDOMNamedNodeMap> attributes;
-    xml->get_attributes(&attributes);
-    long len;
-    attributes->get_length(&len);
+    float* mix = &m_taskMix[task * m_blockSize * 2];
+    float* buffer = &m_workerVoice[worker * m_blockSize * 2];
+    CRenderStats::Instrument* stats = &m_workerStats[worker * m_stats.instruments.size()];
 
-    // Loop over the list of attributes
-    for (int i = 0; i < len; i++)
+    // Mixing here counts as rendering, but not as any one instrument's
+    unsigned long long clock = CycleCount();
+    for (int v = begin; v < end; v++)
     {
-        // Get attribute i
-        CComPtr<IXMLDOMNode> attrib;
-        attributes->get_item(i, &attrib);
+        Voice& voice = m_voices[v];
+        if (!voice.instrument->IsThreadSafe())
+            continue;
+
+        int offset = voice.offset;
+        m_voiceDone[v] = !RenderVoice(voice, buffer, frames, stats[voice.type], clock);
+        MixVoice(mix, 2, buffer, frames - offset, offset);
+        clock = CycleCount();
+    }
+}
 
-        // Get the name of the attribute
-        CComBSTR name;
-        attrib->get_nodeName(&name);
+//
+// Size the stats for the instrument types and worker threads
+// we have, so keeping them never allocates while rendering.
+//
 
-        // Get the value of the attribute.  
-        CComVariant value;
-        attrib->get_nodeValue(&value);
+void CSynthesizer::AllocateStats()
+{
+    m_stats.instruments.resize(m_pools.size());
+    m_workerStats.assign(m_workers.GetNumThreads() * m_pools.size(), CRenderStats::Instrument());
 
-        if (name == "instrument")
-        {
-            instrument = value.bstrVal;
-        }
-    }
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_statsSnapshot = m_stats;
+}
+
+void CSynthesizer::ResetStats()
+{
+    m_stats = CRenderStats();
+    m_stats.instruments.resize(m_pools.size());
+
+    m_dispatchCycles = 0;
+    m_renderCycles = 0;
+    m_mixCycles = 0;
+    m_advanceCycles = 0;
+    m_rateStart = 0;
+    m_rateNotes = 0;
+    m_statsPublished = 0;
+    m_statsStartTime = std::chrono::steady_clock::now();
+    m_statsStartCycles = CycleCount();
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_statsSnapshot = m_stats;
+}
 
+//
+// Name :        CSynthesizer::UpdateStats()
+// Description : Account for a block of frames frames that voices voices
+//               played in, then publish the stats every StatsInterval
+//               frames and at the end of the score.  Blocks are timed in
+//               cycles, which are cheaper to read than the clock, and
+//               converted to seconds with the ratio of cycles to clock
+//               time since Start().
+//
+
+void CSynthesizer::UpdateStats(int frames, int voices)
+{
+    m_stats.activeVoices = voices;
+    if (voices > m_stats.peakVoices)
+        m_stats.peakVoices = voices;
+
+    m_stats.frames += frames;
 
-    CComPtr<IXMLDOMNode> node;
-    xml->get_firstChild(&node);
-    for (; node != NULL; NextNode(node))
+    // The note-on rate is counted over each second of audio
+    if (m_sample - m_rateStart >= GetSampleRate())
     {
-        // Get the name of the node
-        CComBSTR name;
-        node->get_nodeName(&name);
+        m_stats.noteOnsPerSecond = m_rateNotes / ((m_sample - m_rateStart) * GetSamplePeriod());
+        m_rateStart = m_sample;
+        m_rateNotes = 0;
+    }
 
-        if (name == L"note")
-        {
-            XmlLoadNote(node, instrument);
-        }
-        if (name == L"wavetable")
-        {
-            XmlLoadWavetable(node, instrument);
-        }
+    // Working the rest out for every block would cost more than
+    // rendering a silent block does
+    if (m_stats.frames - m_statsPublished < StatsInterval && !IsDone())
+        return;
+
+    m_statsPublished = m_stats.frames;
+
+    double clock = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_statsStartTime).count();
+    unsigned long long sinceStart = CycleCount() - m_statsStartCycles;
+    double secondsPerCycle = sinceStart > 0 ? clock / sinceStart : 0;
+
+    m_stats.elapsedSeconds = (m_dispatchCycles + m_renderCycles + m_advanceCycles) * secondsPerCycle;
+    m_stats.dispatchSeconds = m_dispatchCycles * secondsPerCycle;
+    m_stats.renderSeconds = (m_renderCycles - m_mixCycles) * secondsPerCycle;
+    m_stats.mixSeconds = m_mixCycles * secondsPerCycle;
+    m_stats.advanceSeconds = m_advanceCycles * secondsPerCycle;
+
+    if (m_stats.elapsedSeconds > 0)
+        m_stats.realtimeFactor = m_stats.frames * GetSamplePeriod() / m_stats.elapsedSeconds;
+
+    m_stats.voicesRetired = 0;
+    for (size_t i = 0; i < m_stats.instruments.size(); i++)
+    {
+        CRenderStats::Instrument& stats = m_stats.instruments[i];
+        stats.cyclesPerSample = stats.samples > 0 ? double(stats.cycles) / stats.samples : 0;
+        m_stats.voicesRetired += stats.retired;
     }
+
+    // Whoever is reading the snapshot gets the next one instead
+    std::unique_lock<std::mutex> lock(m_statsMutex, std::try_to_lock);
+    if (lock.owns_lock())
+        m_statsSnapshot = m_stats;
 }
 
-void CSynthesizer::XmlLoadNote(IXMLDOMNode* xml, std::wstring& instrument)
+CRenderStats CSynthesizer::GetRenderStats()
 {
-    if (instrument == L"WavetableInstrument") m_notes.push_back(CWaveNote());
-    else m_notes.push_back(CNote());
-    m_notes.back().XmlLoad(xml, instrument);
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_statsSnapshot;
 }
 
-void CSynthesizer::XmlLoadWavetable(IXMLDOMNode* xml, std::wstring& instrument)
+//
+// Return every active instrument to its pool
+//
+
+void CSynthesizer::ReleaseVoices()
 {
-    CComPtr<IXMLDOMNode> node;
-    xml->get_firstChild(&node);
-    for (; node != NULL; NextNode(node))
-    {
-        // Get the name of the node
-        CComBSTR name;
-        node->get_nodeName(&name);
-        if (name == L"wav")
-        {
-            XmlLoadWave(node, instrument);
-        }
-    }
+    for (size_t v = 0; v < m_voices.size(); v++)
+        m_voices[v].instrument->Pool()->Release(m_voices[v].instrument);
+
+    m_voices.clear();
+    m_streamer.ReleaseAll();
 }
 
-void CSynthesizer::XmlLoadWave(IXMLDOMNode* xml, std::wstring& instrument)
+//
+// Size the voice pools for the score we just loaded so that
+// rendering never has to allocate an instrument.
+//
+
+void CSynthesizer::SizeVoicePools()
 {
-    // Get a list of all attribute nodes and the
-    // length of that list
-    CComPtr<IXMLDOMNamedNodeMap> attributes;
-    xml->get_attributes(&attributes);
-    long len;
-    attributes->get_length(&len);
+    ReleaseVoices();
 
-    // Loop over the list of attributes
-    for (int i = 0; i < len; i++)
+    int voices = 0;
+    for (int id = 0; id < (int)m_pools.size(); id++)
     {
-        // Get attribute i
-        CComPtr<IXMLDOMNode> attrib;
-        attributes->get_item(i, &attrib);
+        // A .scorebin knows its peaks, down to some sample rate
+        bool known = id < (int)m_peakPolyphony.size() && m_peakPolyphony[id] >= 0 &&
+            GetSampleRate() >= m_peakRate;
 
-        // Get the name of the attribute
-        CComBSTR name;
-        attrib->get_nodeName(&name);
+        int peak = known ? m_peakPolyphony[id] : PeakPolyphony(id);
+        m_pools[id]->Reserve(peak);
+        voices += peak;
+    }
 
-        // Get the value of the attribute.  
-        CComVariant value;
-        attrib->get_nodeValue(&value);
+    // Only voices playing a streamed wave need a stream cursor
+    bool streamed = false;
+    for (size_t w = 0; w < m_waveTable.size(); w++)
+    {
+        if (m_waveTable[w] != NULL && m_waveTable[w]->IsStreamed())
+            streamed = true;
+    }
+
+    m_streamer.Reserve(streamed ? PeakPolyphony(m_wavetableId, true) : 0);
+
+    m_voices.reserve(voices);
+    m_voiceDone.resize(voices);
+}
+
+//
+// The most notes of one instrument that are ever playing at once,
+// or if streamed, the most wavetable notes on streamed waves.  A
+// note holds its voice from its start until its duration is up.
+//
+
+int CSynthesizer::PeakPolyphony(int instrument, bool streamed)
+{
+    // The instruments convert note durations at 120 bpm (see SetNote)
+    // and default to 0.1 seconds.  A voice is only returned to its pool
+    // at the end of the block it finishes in, so pad the end by the
+    // largest block plus a couple of frames.
+    const double noteSecPerBeat = 60. / 120.;
+    double pad = (MaxBlockSize + 2) * GetSamplePeriod();
+
+    // Start (+1) and end (-1) times of each note
+    std::vector<std::pair<double, int> > events;
+
+    for (size_t i = 0; i < m_numNotes; i++)
+    {
+        const CNote& note = m_score[i];
+        if (note.Instrument() != instrument)
+            continue;
 
-        if (name == "path")
+        if (streamed)
         {
-            // LOAD FROM FILEPATH
-            string filepath = CanonicalPath(string(*m_filename_cache + "\\" + value.bstrVal));
-            char* patharr = new char[filepath.length() + 1];
-            strcpy(patharr, filepath.c_str());
-            CStringW cstrpath = CStringW(patharr);
-            //ALL IS GOOD UP UNTIL HERE BUT I CAN'T FIGURE OUT HOW TO PROPERLY CONVERT TO LPCTSTR. also even doing it a different way it doesn't work for some reason
-            AddWaveToTable((LPCTSTR)patharr);
+            // The wave the note plays, as picked when it starts
+            int waveIndex = note.WaveIndex();
+            if (waveIndex < 0 || waveIndex >= (int)m_waveTable.size()) waveIndex = 0;
+            if (m_waveTable.empty() || m_waveTable[waveIndex] == NULL || !m_waveTable[waveIndex]->IsStreamed())
+                continue;
         }
+
+        double start = (note.Measure() * m_beatspermeasure + note.Beat()) * m_secperbeat;
+        double length = note.Duration() >= 0 ? note.Duration() * noteSecPerBeat : 0.1;
+
+        events.push_back(std::make_pair(start, 1));
+        events.push_back(std::make_pair(start + length + pad, -1));
     }
+
+    // At equal times visit the starts first, so notes that
+    // touch count as overlapping.
+    std::sort(events.begin(), events.end(),
+        [](const std::pair<double, int>& a, const std::pair<double, int>& b)
+        { return a.first < b.first || (a.first == b.first && a.second > b.second); });
+
+    int playing = 0;
+    int peak = 0;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        playing += events[i].second;
+        if (playing > peak)
+            peak = playing;
+    }
+
+    return peak;
+}
+
+void CSynthesizer::Clear(void)
+{
+    ReleaseVoices();
+    m_notes.clear();
+    m_scoreBin.Close();
+    m_score = NULL;
+    m_numNotes = 0;
+    m_peakPolyphony.clear();
+    m_scoreWaves.clear();
+    m_noteSamples.clear();
+    m_scoreFrames = 0;
 }
 
-string CSynthesizer::CanonicalPath(string path)
+//
+// Name :        CSynthesizer::OpenScore()
+// Description : Load a score file, replacing any score we had.
+// Returns :     true if successful, otherwise GetError() says why.
+//
+
+bool CSynthesizer::OpenScore(LPCTSTR filename)
 {
-    list<string> canonical_path = list<string>();
-    bool loop = true;
-    size_t previous = 0;
-    const string delim[] = { "/", "\\", "\\\\" };
-    constexpr int delimcount = sizeof(delim) / sizeof(delim[0]);
-    size_t next[delimcount];
-    int closest = -1;
-    
-    for (int i = 0; i < delimcount; i++)
+    Clear();
+
+    // Waves in the score are relative to the score's directory
+    m_scoreDir = filename;
+    size_t slash = m_scoreDir.find_last_of(L"/\\");
+    m_scoreDir.erase(slash == wstring::npos ? 0 : slash + 1);
+
+    // A compiled score is mapped, not parsed
+    size_t length = wcslen(filename);
+    if (length > 9 && wcscmp(filename + length - 9, L".scorebin") == 0)
+        return OpenScoreBin(filename);
+
+    //
+    // Read the XML score a tag at a time, adding each note as we
+    // come to it.  Top level tag is <score>, holding <instrument>
+    // tags, which hold <note> tags and <wavetable> tags of <wav>s.
+    //
+
+    CXmlReader xml;
+    if (!xml.Open(filename, m_error))
     {
-        next[i] = path.find(delim[i], previous);
-        if (next[i] != string::npos && (closest < 0 || next[i] < next[closest])) closest = i;
+        m_error = L"Failed to open XML score file: " + m_error;
+        return false;
     }
-    if (closest < 0) loop = false;
 
-    std::string token;
-    while (loop)
+    // Which of the tags we know the current element is inside
+    bool score = false;
+    bool instrumentTag = false;
+    bool wavetable = false;
+    int instrument = CInstrumentRegistry::Unknown;
+
+    while (true)
     {
-        token = path.substr(previous, next[closest] - previous);
-        if (token == "..")
+        CXmlReader::Event event = xml.Next();
+        if (event == CXmlReader::EndDocument)
+            break;
+
+        if (event == CXmlReader::Error)
         {
-            canonical_path.pop_back();
+            m_error = L"Failed to open XML score file: " + xml.GetError();
+            Clear();
+            return false;
         }
-        else if (token == ".")
+
+        if (event != CXmlReader::StartElement)
+            continue;
+
+        const string& name = xml.Name();
+
+        switch (xml.Depth())
         {
-            // nothing
+        case 1:
+            score = name == "score";
+            if (score)
+                XmlLoadScore(xml);
+            break;
+
+        case 2:
+            instrumentTag = score && name == "instrument";
+            if (instrumentTag)
+                instrument = XmlLoadInstrument(xml);
+            break;
+
+        case 3:
+            wavetable = instrumentTag && name == "wavetable";
+            if (instrumentTag && name == "note")
+                XmlLoadNote(xml, instrument);
+            break;
+
+        case 4:
+            if (wavetable && name == "wav")
+                XmlLoadWave(xml);
+            break;
         }
-        else if (token.find(".score") != string::npos)
+    }
+
+    sort(m_notes.begin(), m_notes.end());
+    m_score = m_notes.empty() ? NULL : &m_notes[0];
+    m_numNotes = m_notes.size();
+
+    CompileSchedule();
+    SizeVoicePools();
+
+    return true;
+}
+
+void CSynthesizer::XmlLoadScore(const CXmlReader& xml)
+{
+    // Loop over the list of attributes
+    for (int i = 0; i < xml.NumAttributes(); i++)
+    {
+        // Get the name and value of attribute i
+        const char* name = xml.AttributeName(i);
+        const char* value = xml.AttributeValue(i);
+
+        if (strcmp(name, "bpm") == 0)
         {
-            // nothing
+            m_bpm = strtod(value, NULL);
+            m_secperbeat = 1 / (m_bpm / 60);
         }
-        else
+        else if (strcmp(name, "beatspermeasure") == 0)
         {
-            canonical_path.push_back(token);
+            m_beatspermeasure = strtol(value, NULL, 10);
         }
+    }
+}
 
-        previous = next[closest] + (delim[closest]).length();
-        closest = -1;
-        for (int i = 0; i < delimcount; i++)
+int CSynthesizer::XmlLoadInstrument(const CXmlReader& xml)
+{
+    int instrument = CInstrumentRegistry::Unknown;
+
+    // Loop over the list of attributes.  The instrument name
+    // is resolved to its type id here, once for all its notes.
+    for (int i = 0; i < xml.NumAttributes(); i++)
+    {
+        if (strcmp(xml.AttributeName(i), "instrument") == 0)
         {
-            next[i] = path.find(delim[i], previous);
-            if (next[i] != string::npos && (closest < 0 || next[i] < next[closest])) closest = i;
+            const char* value = xml.AttributeValue(i);
+            instrument = m_registry.Find(Utf8ToWide(value, strlen(value)));
         }
-        if (closest < 0) loop = false;
     }
 
-    
+    return instrument;
+}
+
+void CSynthesizer::XmlLoadNote(const CXmlReader& xml, int instrument)
+{
+    m_notes.push_back(CNote());
+    m_notes.back().XmlLoad(xml, instrument, m_tuning);
+}
 
-    string final = "";
-    for (string part : canonical_path) final = final + part + "\\";
-    token = path.substr(previous);
-    // final remaining token
-    if (token == "..")
+void CSynthesizer::XmlLoadWave(const CXmlReader& xml)
+{
+    // Loop over the list of attributes
+    for (int i = 0; i < xml.NumAttributes(); i++)
     {
-        canonical_path.pop_back();
+        if (strcmp(xml.AttributeName(i), "path") == 0)
+        {
+            const char* value = xml.AttributeValue(i);
+            AddScoreWave(Utf8ToWide(value, strlen(value)));
+        }
     }
-    else if (token == ".")
+}
+
+//
+// Add a wave the score names to the wave table.  Relative
+// paths are relative to the score.
+//
+
+void CSynthesizer::AddScoreWave(const wstring& path)
+{
+    m_scoreWaves.push_back(path);
+
+    bool absolute = !path.empty() && (path[0] == L'/' || path[0] == L'\\' ||
+        (path.size() > 1 && path[1] == L':'));
+
+    AddWaveToTable((absolute ? path : m_scoreDir + path).c_str());
+}
+
+//
+// Name :        CSynthesizer::OpenScoreBin()
+// Description : Map a compiled score and play its notes where they
+//               lie.  Notes carry the instrument type ids of the
+//               synthesizer that wrote the file; if ours differ, the
+//               notes are copied with their ids changed.
+//
+
+bool CSynthesizer::OpenScoreBin(LPCTSTR filename)
+{
+    if (!m_scoreBin.Open(filename, m_error))
     {
-        // nothing
+        m_error = L"Failed to open compiled score file: " + m_error;
+        return false;
     }
-    else if (token.find(".score") != string::npos)
+
+    const CScoreBin::Tempo& tempo = m_scoreBin.GetTempo(0);
+    m_bpm = tempo.bpm;
+    m_secperbeat = 1 / (m_bpm / 60);
+    m_beatspermeasure = int(tempo.beatsPerMeasure);
+
+    bool same = true;
+    std::vector<int> ids(m_scoreBin.NumInstruments());
+    m_peakPolyphony.assign(m_pools.size(), -1);
+    m_peakRate = m_scoreBin.PolyphonyRate();
+
+    for (int i = 0; i < m_scoreBin.NumInstruments(); i++)
+    {
+        ids[i] = m_registry.Find(m_scoreBin.InstrumentName(i));
+        if (ids[i] != i)
+            same = false;
+        if (ids[i] != CInstrumentRegistry::Unknown)
+            m_peakPolyphony[ids[i]] = m_scoreBin.PeakPolyphony(i);
+    }
+
+    if (same)
     {
-        // nothing
+        m_score = m_scoreBin.Notes();
+        m_numNotes = m_scoreBin.NumNotes();
     }
     else
     {
-        canonical_path.push_back(token);
+        m_notes.assign(m_scoreBin.Notes(), m_scoreBin.Notes() + m_scoreBin.NumNotes());
+        for (size_t i = 0; i < m_notes.size(); i++)
+        {
+            int id = m_notes[i].Instrument();
+            m_notes[i].SetInstrument(id >= 0 && id < (int)ids.size() ? ids[id] : CInstrumentRegistry::Unknown);
+        }
+
+        m_score = m_notes.empty() ? NULL : &m_notes[0];
+        m_numNotes = m_notes.size();
     }
-    final = final + token;
 
-    return final;
-}
\ No newline at end of file
+    for (int i = 0; i < m_scoreBin.NumWaves(); i++)
+        AddScoreWave(m_scoreBin.WavePath(i));
+
+    CompileSchedule();
+    SizeVoicePools();
+
+    return true;
+}
+
+//
+// Name :        CSynthesizer::SaveScoreBin()
+// Description : Write the score we have loaded as a .scorebin.
+// Returns :     true if successful, otherwise GetError() says why.
+//
+
+bool CSynthesizer::SaveScoreBin(LPCTSTR filename)
+{
+    CScoreBin::Tempo tempo;
+    tempo.beat = 0;
+    tempo.bpm = m_bpm;
+    tempo.beatsPerMeasure = uint32_t(m_beatspermeasure);
+    tempo.reserved = 0;
+
+    std::vector<std::wstring> instruments;
+    std::vector<int> peaks;
+    for (int id = 0; id < m_registry.Count(); id++)
+    {
+        instruments.push_back(m_registry.Name(id));
+        peaks.push_back(PeakPolyphony(id));
+    }
+
+    return CScoreBin::Write(filename, tempo, instruments, peaks, GetSampleRate(),
+        m_score, m_numNotes, m_scoreWaves, m_error);
+}
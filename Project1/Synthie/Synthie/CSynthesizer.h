@@ -1,17 +1,30 @@
 #pragma once
-#include <list>
+#include <memory>
 #include <CToneInstrument.h>
 #include <CWavetableInstrument.h>
-#include "msxml2.h"
 #include <string>
 #include <CNote.h>
-#include <CWaveNote.h>
+#include <CVoicePool.h>
+#include <CInstrumentRegistry.h>
+#include <CWorkerPool.h>
+#include <CSampleStreamer.h>
+#include <CScoreBin.h>
+#include <CRenderStats.h>
+#include <mutex>
 
 using namespace std;
 
 class CSynthesizer
 {
 	public:
+    //! Which voice to stop when a note starts at the polyphony limit
+    enum StealPolicy
+    {
+        StealOldest,            //!< The voice that started first
+        StealQuietest,          //!< The voice whose last block was quietest
+        StealLowestPriority     //!< A voice of the lowest priority instrument, the oldest of those
+    };
+
 	//! Number of audio channels
     int GetNumChannels() {return m_channels;}
 
@@ -25,44 +38,221 @@ class CSynthesizer
     void SetNumChannels(int n) {m_channels = n;}
 
 	//! Set the sample rate
-    void SetSampleRate(double s) {m_sampleRate = s;  m_samplePeriod = 1.0 / s;}
+    /*! If a score is loaded, its voices are released and the voice
+     *  pools sized again for the new rate. */
+    void SetSampleRate(double s);
 
-    //! Set the wave table
-    void AddWaveToTable(LPCTSTR w) { m_waveTable.push_back(&CWaveIn(w)); }
+    //! Load a wave into the end of the wave table
+    /*! A wave that can't be loaded keeps its place in the table and plays silence. */
+    void AddWaveToTable(LPCTSTR w);
 
     //! Clear the wave table
     void ClearWaveTable() {m_waveTable.clear();}
 
+    //! Load a Scala .scl tuning for the scores loaded after it
+    /*! Returns false, and GetError() says why, if it can't be used */
+    bool LoadTuning(LPCTSTR filename);
+
+    //! The tuning scores are loaded with
+    CTuning& GetTuning() {return m_tuning;}
+
+    //! Beats per minute of the score
+    double GetBpm() {return m_bpm;}
+
+    //! Beats per measure of the score
+    int GetBeatsPerMeasure() {return m_beatspermeasure;}
+
+    //! The notes of the score, sorted by start time
+    const CNote* GetNotes() {return m_score;}
+
+    //! Number of notes in the score
+    size_t GetNumNotes() {return m_numNotes;}
+
+    //! Wavetable waves the score names, as the score gives their paths
+    const std::vector<std::wstring>& GetScoreWaves() {return m_scoreWaves;}
+
+    //! Set the number of frames rendered per block (clamped to 64 to 1024)
+    void SetBlockSize(int frames);
+
+    //! Number of frames rendered per block
+    int GetBlockSize() {return m_blockSize;}
+
+    //! Frames from the start of the score to the end of its last note
+    long long GetScoreFrames() {return m_scoreFrames;}
+
+    //! Set the number of threads that render voices (1 renders on the caller only)
+    void SetNumThreads(int threads);
+
+    //! Number of threads that render voices
+    int GetNumThreads() {return m_workers.GetNumThreads();}
+
+    //! Stream waves with more sample data than this from disk (0 never streams)
+    /*! Only the head of a streamed wave is held in memory. Affects
+     *  waves loaded after the call. */
+    void SetStreamThreshold(size_t bytes) { m_streamBytes = bytes; }
+
+    //! Should voices wait for streamed waves rather than play silence?
+    /*! Set this for offline rendering, where there is no deadline. */
+    void SetStreamBlocking(bool blocking) { m_streamer.SetBlocking(blocking); }
+
+    //! Frames of streamed waves that were not read from disk in time
+    long long GetStreamUnderruns() const { return m_streamer.Underruns(); }
+
+    //! Register an instrument type that scores can name, returning its type id
+    /*! Call before OpenScore(), which sizes the voice pools. */
+    int RegisterInstrument(const wchar_t* name, CInstrumentRegistry::PoolFactory factory);
+
+    //! Set the most voices that play at once (0, the default, has no limit)
+    /*! A note that starts when this many are playing takes the place of
+     *  one the steal policy picks, which fades out over a few
+     *  milliseconds. Keeps the cost of a block bounded for realtime
+     *  playback, however densely the score stacks its notes. */
+    void SetMaxPolyphony(int voices) {m_maxPolyphony = voices > 0 ? voices : 0;}
+
+    //! The most voices that play at once, 0 for no limit
+    int GetMaxPolyphony() {return m_maxPolyphony;}
+
+    //! Set which voice is stolen at the polyphony limit
+    void SetStealPolicy(StealPolicy policy) {m_stealPolicy = policy;}
+
+    StealPolicy GetStealPolicy() {return m_stealPolicy;}
+
+    //! Set the priority of an instrument type id for StealLowestPriority (default 0)
+    void SetInstrumentPriority(int id, int priority);
+
+    //! Retire voices quieter than threshold for seconds (threshold 0 never does)
+    /*! A voice whose output peaks below threshold, block after block,
+     *  for seconds stops there instead of playing silence to the end of
+     *  its note. Only silence after the voice has first gone above
+     *  threshold counts, so a quiet lead in is played. The default is
+     *  -100 dB (0.00001) for 0.1 seconds. Takes effect at the next
+     *  Start(). */
+    void SetSilence(double threshold, double seconds);
+
+    //! The name an instrument type id was registered with
+    const std::wstring& GetInstrumentName(int id) {return m_registry.Name(id);}
+
+    //! What the render is doing, as of a block rendered in the last 4096 frames
+    /*! Safe to call from any thread while another renders. The
+     *  rendering thread never waits for it; if it is being read, the
+     *  next update comes a little later. It is up to date once the
+     *  score is done. */
+    CRenderStats GetRenderStats();
+
 private:
     int		m_channels;
     double	m_sampleRate;
     double	m_samplePeriod;
     double  m_time;
-    std::list<CInstrument*>  m_instruments;
+
+    //! A note that is playing
+    struct Voice
+    {
+        CInstrument* instrument;
+        int     offset;         //!< Frame in the current block it starts on
+        int     type;           //!< Instrument type id
+        int     note;           //!< Index of its note, so lower is older
+        float   level;          //!< Loudest sample of its last block, if stealing needs it
+        int     fade;           //!< Frames left of its fade out once stolen, otherwise 0
+        int     fadeStart;      //!< Frame of the current block its fade starts on
+        bool    rendered;       //!< Has it rendered a block yet?
+        bool    sounded;        //!< Has it gone above the silence threshold yet?
+        int     silent;         //!< Frames in a row it has been below the threshold since
+    };
+
+    std::vector<Voice> m_voices;        //!< Active voices, reserved at OpenScore
+    int     m_maxPolyphony;         //!< Most voices at once, 0 for no limit
+    StealPolicy m_stealPolicy;      //!< Which voice to steal at the limit
+    std::vector<int> m_priorities;  //!< Steal priority of each instrument type id
+    int     m_fadeFrames;           //!< Length of a stolen voice's fade
+    double  m_silenceThreshold;     //!< Level a voice is silent below, 0 to never retire one
+    double  m_silenceTime;          //!< Seconds a voice is silent for before it is retired
+    int     m_silenceFrames;        //!< m_silenceTime in frames, from Start()
+    CInstrumentRegistry m_registry;     //!< Instrument types scores can use
+    std::vector<std::unique_ptr<CVoicePoolBase> > m_pools;  //!< Voice pool for each instrument type id
+    int     m_toneId;               //!< Type id of ToneInstrument
+    int     m_wavetableId;          //!< Type id of WavetableInstrument
     double  m_bpm;                  //!< Beats per minute
     int     m_beatspermeasure;  //!< Beats per measure
     double  m_secperbeat;        //!< Seconds per beat
-    std::vector<CNote> m_notes;
+    std::vector<CNote> m_notes;     //!< Notes loaded from XML
+    CScoreBin m_scoreBin;           //!< Notes mapped from a .scorebin
+    const CNote* m_score;           //!< The notes we play, in m_notes or m_scoreBin
+    size_t  m_numNotes;             //!< Notes in m_score
+    std::vector<int> m_peakPolyphony;   //!< Peak voices for each type id from a .scorebin, -1 if not known
+    double  m_peakRate;             //!< Sample rate m_peakPolyphony holds from
+    std::vector<std::wstring> m_scoreWaves; //!< Paths of the waves the score names
+    CTuning m_tuning;               //!< Frequencies of the note names
+    std::vector<long long> m_noteSamples;   //!< Start frame of each note in m_notes
+    long long m_scoreFrames;    //!< Frame the last note ends on
     int m_currentNote;          //!< The current note we are playing
-    int m_measure;              //!< The current measure
-    double m_beat;              //!< The current beat within the measure
-    std::vector<CWaveIn*> m_waveTable;
-    CString* m_filename_cache;
+    long long m_sample;         //!< Frames generated since Start()
+    std::vector<CSampleBufferPtr> m_waveTable;
+    size_t  m_streamBytes;          //!< Waves bigger than this are streamed
+    CSampleStreamer m_streamer;     //!< Reads streamed waves for the voices
+    std::wstring m_scoreDir;        //!< Directory of the score being loaded
+    std::wstring m_error;           //!< Why the last OpenScore failed
+
+    int     m_blockSize;            //!< Frames rendered per block
+    std::vector<float> m_voiceBlock;    //!< Output of a single voice (stereo)
+    std::vector<float> m_block;     //!< Block buffer that feeds Generate()
+    int     m_blockFrames;          //!< Valid frames in m_block
+    int     m_blockPos;             //!< Next frame of m_block for Generate()
+
+    CWorkerPool m_workers;          //!< Threads for rendering voices in parallel
+    std::vector<float> m_taskMix;   //!< A stereo mix block for each parallel task
+    std::vector<float> m_workerVoice;   //!< A voice block for each worker
+    std::vector<char> m_voiceDone;  //!< Voices that finished in this block
+
+    CRenderStats m_stats;           //!< Stats of the render, kept by the rendering thread
+    CRenderStats m_statsSnapshot;   //!< m_stats as of the last block, for GetRenderStats()
+    std::mutex m_statsMutex;        //!< Guards m_statsSnapshot
+    std::vector<CRenderStats::Instrument> m_workerStats;   //!< Voice costs on each worker, by type id
+    unsigned long long m_dispatchCycles;    //!< Cycles in each phase since Start()
+    unsigned long long m_renderCycles;      //!< Includes m_mixCycles
+    unsigned long long m_mixCycles;
+    unsigned long long m_advanceCycles;
+    long long m_rateStart;          //!< Frame the note-on rate is being counted from
+    long long m_rateNotes;          //!< Notes started since m_rateStart
+    long long m_statsPublished;     //!< Frame the snapshot was last updated on
+    std::chrono::steady_clock::time_point m_statsStartTime;    //!< Clock and cycles at Start(),
+    unsigned long long m_statsStartCycles;                      //!< to turn cycles into seconds
+
+    void CompileSchedule();
+    bool OpenScoreBin(LPCTSTR filename);
+    void AddScoreWave(const std::wstring& path);
+    int QuietFrames(int frames);
+    void StartNotes(int frames);
+    void StealVoice(int offset);
+    bool StealFirst(const Voice& a, const Voice& b);
+    bool RenderVoice(Voice& voice, float* buffer, int frames,
+        CRenderStats::Instrument& stats, unsigned long long& clock);
+    void RenderVoices(float* out, int frames);
+    void RenderTask(int task, int tasks, int worker, int frames);
+    void AllocateRenderBuffers();
+    void AllocateStats();
+    void ResetStats();
+    void UpdateStats(int frames, int voices);
+    void ReleaseVoices();
+    void SizeVoicePools();
+    int PeakPolyphony(int instrument, bool streamed = false);
+    bool IsDone() {return m_voices.empty() && m_currentNote >= (int)m_numNotes;}
 
 public:
     CSynthesizer();
     void Start();
     bool Generate(double* frame);
+    int GenerateBlock(float* out, int frames);
     //! Get the time since we started generating audio
     double GetTime() { return m_time; }
     void Clear(void);
-    void OpenScore(CString& filename);
-    void XmlLoadScore(IXMLDOMNode* xml);
-    void XmlLoadInstrument(IXMLDOMNode* xml);
-    void XmlLoadNote(IXMLDOMNode* xml, std::wstring& instrument);
-    void XmlLoadWavetable(IXMLDOMNode* xml, std::wstring& instrument);
-    void XmlLoadWave(IXMLDOMNode* xml, std::wstring& instrument);
-    string CanonicalPath(string path);
+    bool OpenScore(LPCTSTR filename);
+    //! Write the score as a .scorebin, with voice counts for the current sample rate
+    bool SaveScoreBin(LPCTSTR filename);
+    //! Why the last OpenScore() failed
+    const std::wstring& GetError() { return m_error; }
+    void XmlLoadScore(const CXmlReader& xml);
+    int XmlLoadInstrument(const CXmlReader& xml);
+    void XmlLoadNote(const CXmlReader& xml, int instrument);
+    void XmlLoadWave(const CXmlReader& xml);
 };
-
-#pragma comment(lib, "msxml2.lib")
\ No newline at end of file
@@ -1,6 +1,5 @@
 #include "pch.h"
 #include "CToneInstrument.h"
-#include <Notes.h>
 
 CToneInstrument::CToneInstrument()
 {
@@ -43,42 +42,53 @@ bool CToneInstrument::Generate()
     return m_time < m_duration;
 }
 
-void CToneInstrument::SetNote(CNote* note)
+bool CToneInstrument::GenerateBlock(float* out, int frames)
 {
-    // Get a list of all attribute nodes and the
-    // length of that list
-    CComPtr<IXMLDOMNamedNodeMap> attributes;
-    note->Node()->get_attributes(&attributes);
-    long len;
-    attributes->get_length(&len);
-
-    // Loop over the list of attributes
-    for (int i = 0; i < len; i++)
+    // Let the sine wave fill the whole block, then shape it
+    m_sinewave.GenerateBlock(out, frames);
+
+    double period = GetSamplePeriod();
+
+    for (int i = 0; i < frames; i++)
     {
-        // Get attribute i
-        CComPtr<IXMLDOMNode> attrib;
-        attributes->get_item(i, &attrib);
-
-        // Get the name of the attribute
-        CComBSTR name;
-        attrib->get_nodeName(&name);
-
-        // Get the value of the attribute.  A CComVariant is a variable
-        // that can have any type. It loads the attribute value as a
-        // string (UNICODE), but we can then change it to an integer 
-        // (VT_I4) or double (VT_R8) using the ChangeType function 
-        // and then read its integer or double value from a member variable.
-        CComVariant value;
-        attrib->get_nodeValue(&value);
-
-        if (name == "duration")
+        double volumeMultiplier = 1.;
+        if (m_time < m_attack)
         {
-            value.ChangeType(VT_R8);
-            SetDuration(value.dblVal * (60. / 120.));
+            volumeMultiplier = m_time / m_attack;
         }
-        else if (name == "note")
+        else if (m_time > (m_duration - m_release))
         {
-            SetFreq(NoteToFrequency(value.bstrVal));
+            volumeMultiplier = (m_duration - m_time) / m_release;
         }
+
+        out[i * 2] *= float(volumeMultiplier);
+        out[i * 2 + 1] *= float(volumeMultiplier);
+
+        m_time += period;
+
+        if (m_time >= m_duration)
+        {
+            // This frame is past the end, as with Generate(), and
+            // so is everything after it.
+            for (int j = i * 2; j < frames * 2; j++)
+                out[j] = 0;
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void CToneInstrument::SetNote(const CNote* note)
+{
+    if (note->Duration() >= 0)
+    {
+        SetDuration(note->Duration() * (60. / 120.));
+    }
+
+    if (note->Frequency() > 0)
+    {
+        SetFreq(note->Frequency());
     }
 }
@@ -7,11 +7,12 @@ class CToneInstrument :
 public:
     virtual void Start();
     virtual bool Generate();
+    virtual bool GenerateBlock(float* out, int frames);
 
     void SetFreq(double f) { m_sinewave.SetFreq(f); }
     void SetAmplitude(double a) { m_sinewave.SetAmplitude(a); }
     void SetDuration(double d) { m_duration = d; }
-    void SetNote(CNote* note);
+    void SetNote(const CNote* note);
 
 private:
     CSineWave   m_sinewave;
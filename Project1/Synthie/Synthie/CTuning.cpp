@@ -0,0 +1,166 @@
+#include "pch.h"
+#include "CTuning.h"
+#include "Utf8.h"
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+// The original note table, A0 (MIDI 21) to C8 (MIDI 108)
+const int StandardLow = 21;
+static const double StandardFreq[] = {
+    27.5, 29.1352, 30.8677, 32.7032, 34.6478, 36.7081, 38.8909, 41.2034, 43.6535, 46.2493, 48.9994, 51.9131,
+    55.0, 58.2705, 61.7354, 65.4064, 69.2957, 73.4162, 77.7817, 82.4069, 87.3071, 92.4986, 97.9989, 103.826,
+    110.0, 116.541, 123.471, 130.813, 138.591, 146.832, 155.563, 164.814, 174.614, 184.997, 195.998, 207.652,
+    220.0, 233.082, 246.942, 261.626, 277.183, 293.665, 311.127, 329.628, 349.228, 369.994, 391.995, 415.305,
+    440.0, 466.164, 493.883, 523.251, 554.365, 587.33, 622.254, 659.255, 698.456, 739.989, 783.991, 830.609,
+    880.0, 932.328, 987.767, 1046.5, 1108.73, 1174.66, 1244.51, 1318.51, 1396.91, 1479.98, 1567.98, 1661.22,
+    1760.0, 1864.66, 1975.53, 2093.0, 2217.46, 2349.32, 2489.02, 2637.02, 2793.83, 2959.96, 3135.96, 3322.44,
+    3520.0, 3729.31, 3951.07, 4186.01};
+
+CTuning::CTuning()
+{
+    SetStandard();
+}
+
+void CTuning::SetStandard()
+{
+    SetEqual(440);
+
+    for (int i = 0; i < int(sizeof(StandardFreq) / sizeof(StandardFreq[0])); i++)
+        m_freq[StandardLow + i] = StandardFreq[i];
+}
+
+void CTuning::SetEqual(double a4)
+{
+    for (int p = 0; p < NumPitches; p++)
+        m_freq[p] = a4 * pow(2., (p - 69) / 12.);
+}
+
+double CTuning::Frequency(const NotePitch& note) const
+{
+    if (note.pitch < 0)
+        return 0;
+
+    if (note.cents == 0)
+        return m_freq[note.pitch];
+
+    return m_freq[note.pitch] * pow(2., note.cents / 1200);
+}
+
+//
+// A Scala pitch is in cents if it has a decimal point,
+// otherwise it is a ratio like 3/2, or a whole number.
+// Returns the frequency ratio, or 0 if it is not a pitch.
+//
+
+static double ScalaRatio(const string& line)
+{
+    const char* p = line.c_str();
+    while (*p == ' ' || *p == '\t')
+        p++;
+
+    // Only the first word counts; the rest is a comment
+    string word;
+    for (; *p != 0 && *p != ' ' && *p != '\t' && *p != '\r'; p++)
+        word += *p;
+
+    if (word.empty())
+        return 0;
+
+    char* end;
+    if (word.find('.') != string::npos)
+    {
+        double cents = strtod(word.c_str(), &end);
+        return *end == 0 ? pow(2., cents / 1200) : 0;
+    }
+
+    double num = strtod(word.c_str(), &end);
+    double den = 1;
+    if (*end == '/')
+        den = strtod(end + 1, &end);
+
+    return *end == 0 && num > 0 && den > 0 ? num / den : 0;
+}
+
+//
+// Name :        CTuning::LoadScala()
+// Description : A .scl file is a description line, the number of
+//               pitches, and then each pitch of the scale above degree
+//               0.  The last pitch is the interval the scale repeats
+//               at, usually the octave.  Lines starting with ! are
+//               comments.
+//
+
+bool CTuning::LoadScala(LPCTSTR filename, wstring& error, int baseNote, double baseFreq)
+{
+#ifdef SYNTHIE_HEADLESS
+    ifstream file(WideToUtf8(filename).c_str());
+#else
+    ifstream file(filename);
+#endif
+
+    if (!file)
+    {
+        error = wstring(L"Unable to open ") + filename;
+        return false;
+    }
+
+    bool description = false;
+    long count = -1;
+    vector<double> ratios;
+
+    string line;
+    while (getline(file, line))
+    {
+        if (!line.empty() && line[0] == '!')
+            continue;
+
+        if (!description)
+        {
+            description = true;
+        }
+        else if (count < 0)
+        {
+            count = strtol(line.c_str(), NULL, 10);
+            if (count <= 0)
+            {
+                error = wstring(L"No pitches in ") + filename;
+                return false;
+            }
+        }
+        else if ((long)ratios.size() < count)
+        {
+            double ratio = ScalaRatio(line);
+            if (ratio <= 0)
+            {
+                error = wstring(L"Bad pitch in ") + filename;
+                return false;
+            }
+
+            ratios.push_back(ratio);
+        }
+    }
+
+    if (count < 0 || (long)ratios.size() < count || baseFreq <= 0)
+    {
+        error = wstring(L"Incomplete scale in ") + filename;
+        return false;
+    }
+
+    double period = ratios.back();
+    int size = int(ratios.size());
+
+    for (int p = 0; p < NumPitches; p++)
+    {
+        int degree = p - baseNote;
+        int periods = degree >= 0 ? degree / size : -((size - 1 - degree) / size);
+        degree -= periods * size;
+
+        m_freq[p] = baseFreq * pow(period, periods) * (degree == 0 ? 1 : ratios[degree - 1]);
+    }
+
+    return true;
+}
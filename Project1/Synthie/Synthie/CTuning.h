@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include "Notes.h"
+
+//! The frequency of every MIDI pitch
+/*! A tuning is a table of 128 frequencies indexed by MIDI note number,
+ *  so resolving a note is an array lookup. The standard tuning is equal
+ *  temperament at A4 = 440 Hz, keeping the rounded frequencies of the
+ *  original note table from A0 to C8, so scores sound as they always
+ *  have. Other tunings can be loaded from Scala scale files and are
+ *  worked out for every pitch when they are loaded.
+ */
+class CTuning
+{
+public:
+    //! Number of pitches in the table
+    static const int NumPitches = MaxPitch + 1;
+
+    CTuning();
+
+    //! The standard tuning
+    void SetStandard();
+
+    //! Twelve tone equal temperament with A4 at a4 Hz
+    void SetEqual(double a4);
+
+    //! Load a Scala .scl scale
+    /*! Scale degree 0 is put on MIDI pitch baseNote, at baseFreq Hz.
+     *  The default puts it on middle C as equal temperament has it.
+     *  Returns false with a message in error, leaving the tuning as
+     *  it was, if the file can't be used. */
+    bool LoadScala(LPCTSTR filename, std::wstring& error, int baseNote = 60, double baseFreq = 261.6255653);
+
+    //! Frequency of a MIDI pitch in Hz
+    double Frequency(int pitch) const { return m_freq[pitch]; }
+
+    //! Frequency of a pitch and cents in Hz
+    double Frequency(const NotePitch& note) const;
+
+    //! Frequency of a note name in Hz, or zero if it is not a note
+    double NoteToFrequency(const char* name) const { return Frequency(ParseNoteName(name)); }
+
+private:
+    double m_freq[NumPitches];
+};
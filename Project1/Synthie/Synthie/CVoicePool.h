@@ -0,0 +1,102 @@
+#pragma once
+#include "CInstrument.h"
+#include <vector>
+
+//! Fixed-capacity pool of instrument voices
+/*! All of the voices are allocated by Reserve(), when a score is
+ *  opened. Free voices are chained through the instruments themselves,
+ *  so Acquire() and Release() are a couple of pointer moves and never
+ *  touch the heap while we are rendering.
+ */
+class CVoicePoolBase
+{
+public:
+    CVoicePoolBase() : m_free(NULL), m_capacity(0), m_inUse(0) {}
+    virtual ~CVoicePoolBase() {}
+
+    //! Allocate capacity voices, all of them free
+    virtual void Reserve(int capacity) = 0;
+
+    //! Take a voice off the free list, or NULL if the pool is empty
+    CInstrument* Acquire()
+    {
+        CInstrument* voice = m_free;
+        if (voice == NULL)
+            return NULL;
+
+        m_free = voice->m_nextFree;
+        voice->m_nextFree = NULL;
+        m_inUse++;
+        return voice;
+    }
+
+    //! Take a voice, reset to its default state, or NULL if the pool is empty
+    virtual CInstrument* AcquireVoice() = 0;
+
+    //! Put a voice back on the free list
+    void Release(CInstrument* voice)
+    {
+        voice->m_nextFree = m_free;
+        m_free = voice;
+        m_inUse--;
+    }
+
+    //! Number of voices in the pool
+    int Capacity() const { return m_capacity; }
+
+    //! Number of voices currently handed out
+    int InUse() const { return m_inUse; }
+
+protected:
+    //! Make a voice belong to this pool and put it on the free list
+    void Adopt(CInstrument* voice)
+    {
+        voice->m_pool = this;
+        voice->m_nextFree = m_free;
+        m_free = voice;
+    }
+
+    //! Claim a voice that was just reset, keeping it off the free list
+    void Claim(CInstrument* voice) { voice->m_pool = this; }
+
+    CInstrument* m_free;    //!< Head of the free list
+    int m_capacity;
+    int m_inUse;
+};
+
+//! Voice pool for one instrument type
+template<class T> class CVoicePool : public CVoicePoolBase
+{
+public:
+    virtual void Reserve(int capacity)
+    {
+        m_free = NULL;
+        m_inUse = 0;
+        m_capacity = capacity;
+        m_voices = std::vector<T>(capacity);
+
+        // Chain backwards so voices are handed out from the front
+        for (int i = capacity - 1; i >= 0; i--)
+            Adopt(&m_voices[i]);
+    }
+
+    //! Take a voice, reset to its default state, or NULL if the pool is empty
+    T* Acquire()
+    {
+        T* voice = static_cast<T*>(CVoicePoolBase::Acquire());
+        if (voice != NULL)
+        {
+            // Start from a clean instrument so nothing carries over
+            // from the last note this voice played.
+            *voice = T();
+            Claim(voice);
+        }
+
+        return voice;
+    }
+
+    virtual CInstrument* AcquireVoice() { return Acquire(); }
+
+private:
+    std::vector<T> m_voices;
+};
@@ -1,91 +1,196 @@
 #include "pch.h"
 #include "CWavetableInstrument.h"
-#include <Notes.h>
 
 CWavetableInstrument::CWavetableInstrument()
 {
+    m_position = 0;
     m_duration = 0.1;
     m_attack = 0.05;
     m_release = 0.05;
+    m_loopStart = 0;
+    m_loopEnd = 0;          // Zero loops at the end of the wave
+    m_loopStartFrame = 0;
+    m_loopEndFrame = 0;
+    m_streamer = NULL;
+    m_cursor = NULL;
+    m_streaming = false;
 }
 
 void CWavetableInstrument::Start()
 {
     m_time = 0;
-    m_lastLoopTime = -1;
-    //(*m_wavein) = CWaveIn(m_wave);
-    //m_wavein->open(m_wave);
-    m_wavein->Rewind();
+    m_position = 0;
+    StopStreaming();
+
+    if (m_wave == NULL)
+        return;
+
+    // Work out the loop points in frames of the wave itself
+    double waveRate = m_wave->SampleRate();
+    m_loopStartFrame = int(m_loopStart * waveRate);
+    m_loopEndFrame = m_loopEnd > 0 ? int(m_loopEnd * waveRate) : m_wave->NumFrames();
+    if (m_loopEndFrame > m_wave->NumFrames())
+        m_loopEndFrame = m_wave->NumFrames();
+    if (m_loopStartFrame >= m_loopEndFrame)
+        m_loopStartFrame = 0;
+
+    // A streamed wave we play past its head needs a cursor now, so
+    // the disk can get ahead of us while we play the head.
+    if (m_wave->IsStreamed() && m_streamer != NULL && m_loopEndFrame > m_wave->HeadFrames())
+        m_cursor = m_streamer->Acquire(m_wave, m_loopStartFrame, m_loopEndFrame);
 }
 
+//
+// Give back the stream cursor, if we have one
+//
 
-bool CWavetableInstrument::Generate()
+void CWavetableInstrument::StopStreaming()
 {
+    if (m_cursor != NULL)
+        m_cursor->Release();
+
+    m_cursor = NULL;
+    m_streaming = false;
+}
+
+//
+// Attack and release
+//
 
-    // Attack and release
-    double volumeMultiplier = 1.;
+double CWavetableInstrument::Envelope()
+{
     if (m_time < m_attack)
     {
-        volumeMultiplier = m_time / m_attack;
+        return m_time / m_attack;
     }
     else if (m_time > (m_duration - m_release))
     {
-        volumeMultiplier = (m_duration - m_time) / m_release;
+        return (m_duration - m_time) / m_release;
+    }
+
+    return 1.;
+}
+
+//
+// Is there nothing more to read from the wave?  With no wave, or past
+// the head of a streamed wave we have no cursor for, all that is left
+// is silence.
+//
+
+bool CWavetableInstrument::IsSourceDone()
+{
+    return m_wave == NULL || (!m_streaming && m_position >= m_wave->HeadFrames());
+}
+
+//
+// Read the next stereo frame of the designated wave into frame,
+// looping back to the loop start when we hit the loop end.  Past the
+// head of a streamed wave the frames come from the stream cursor.
+//
+
+void CWavetableInstrument::ReadWaveFrame(float* frame)
+{
+    if (m_streaming)
+    {
+        m_cursor->Read(frame);
+        return;
+    }
+
+    if (m_wave == NULL || m_position >= m_wave->HeadFrames())
+    {
+        frame[0] = 0;
+        frame[1] = 0;
+        return;
+    }
+
+    // Mono waves play on both channels
+    frame[0] = m_wave->Channel(0)[m_position];
+    frame[1] = m_wave->NumChannels() > 1 ? m_wave->Channel(1)[m_position] : frame[0];
+
+    m_position++;
+    if (m_position >= m_loopEndFrame)
+        m_position = m_loopStartFrame;
+    else if (m_position >= m_wave->HeadFrames() && m_cursor != NULL)
+        m_streaming = true;
+}
+
+
+bool CWavetableInstrument::Generate()
+{
+    if (IsSourceDone())
+    {
+        m_frame[0] = 0;
+        m_frame[1] = 0;
+        StopStreaming();
+        return false;
     }
 
+    double volumeMultiplier = Envelope();
+
     // Read the sample of the designated wave and make it our resulting frame.
-    m_wavein->ReadFrame(m_shortFrame);
-    m_frame[0] = (double) (m_shortFrame[0] * volumeMultiplier);
-    m_frame[1] = (double) (m_shortFrame[1] * volumeMultiplier);
+    float frame[2];
+    ReadWaveFrame(frame);
+    m_frame[0] = frame[0] * volumeMultiplier;
+    m_frame[1] = frame[1] * volumeMultiplier;
 
     // Update time
     m_time += GetSamplePeriod();
-    if (m_lastLoopTime < 0 && m_time > m_loopEnd) m_lastLoopTime = m_time;
-    else if (m_time - m_lastLoopTime >= m_loopEnd - m_loopStart) {
-        m_lastLoopTime = m_time;
-        m_wavein->Rewind();
-    }
 
     // We return true until the time reaches the duration.
-    return m_time < m_duration;
+    if (m_time < m_duration)
+        return true;
+
+    StopStreaming();
+    return false;
 }
 
-void CWavetableInstrument::SetNote(CNote* note)
+bool CWavetableInstrument::GenerateBlock(float* out, int frames)
 {
-    // Get a list of all attribute nodes and the
-    // length of that list
-    CComPtr<IXMLDOMNamedNodeMap> attributes;
-    note->Node()->get_attributes(&attributes);
-    long len;
-    attributes->get_length(&len);
-
-    // Loop over the list of attributes
-    for (int i = 0; i < len; i++)
+    // Silence to the end of the note is no reason to keep playing
+    if (IsSourceDone())
     {
-        // Get attribute i
-        CComPtr<IXMLDOMNode> attrib;
-        attributes->get_item(i, &attrib);
-
-        // Get the name of the attribute
-        CComBSTR name;
-        attrib->get_nodeName(&name);
-
-        // Get the value of the attribute.  A CComVariant is a variable
-        // that can have any type. It loads the attribute value as a
-        // string (UNICODE), but we can then change it to an integer 
-        // (VT_I4) or double (VT_R8) using the ChangeType function 
-        // and then read its integer or double value from a member variable.
-        CComVariant value;
-        attrib->get_nodeValue(&value);
-
-        if (name == "duration")
-        {
-            value.ChangeType(VT_R8);
-            SetDuration(value.dblVal * (60. / 120.));
-        }
-        else if (name == "note")
+        for (int j = 0; j < frames * 2; j++)
+            out[j] = 0;
+
+        StopStreaming();
+        return false;
+    }
+
+    double period = GetSamplePeriod();
+
+    for (int i = 0; i < frames; i++)
+    {
+        float volumeMultiplier = float(Envelope());
+
+        ReadWaveFrame(out + i * 2);
+        out[i * 2] *= volumeMultiplier;
+        out[i * 2 + 1] *= volumeMultiplier;
+
+        m_time += period;
+
+        if (m_time >= m_duration)
         {
-            SetFreq(NoteToFrequency(value.bstrVal));
+            // Done, the rest of the block is silence
+            for (int j = i * 2; j < frames * 2; j++)
+                out[j] = 0;
+
+            StopStreaming();
+            return false;
         }
     }
+
+    return true;
+}
+
+void CWavetableInstrument::SetNote(const CNote* note)
+{
+    if (note->Duration() >= 0)
+    {
+        SetDuration(note->Duration() * (60. / 120.));
+    }
+
+    if (note->Frequency() > 0)
+    {
+        SetFreq(note->Frequency());
+    }
 }
@@ -1,8 +1,9 @@
 #pragma once
 #include "CInstrument.h"
-#include "audio/Wave.h"
+#include "CSampleBuffer.h"
+#include "CSampleStreamer.h"
 #include <CSineWave.h>
-#include <CWaveNote.h>
+#include <CNote.h>
 #include <list>
 #include <algorithm>
 class CWavetableInstrument :
@@ -11,24 +12,26 @@ class CWavetableInstrument :
 public:
     virtual void Start();
     virtual bool Generate();
+    virtual bool GenerateBlock(float* out, int frames);
 
     void SetFreq(double f) { m_sinewave.SetFreq(f); }
     void SetAmplitude(double a) { m_sinewave.SetAmplitude(a); }
     void SetDuration(double d) { m_duration = d; }
-    void SetNote(CNote* note);
-    void SetWave(CWaveIn* w) { m_wavein = w; }
+    void SetNote(const CNote* note);
+    void SetWave(const CSampleBufferPtr& w) { m_wave = w; }
+    //! Where to get the frames of a streamed wave past its head
+    void SetStreamer(CSampleStreamer* s) { m_streamer = s; }
     void SetLoopStart(double s) { m_loopStart = s; }
     void SetLoopEnd(double e) { m_loopEnd = e; }
 
-    //! Access a generated audio frame
-    virtual const double* Frame() { return m_frame; }
-
-    //! Access one channel of a generated audio frame
-    virtual double Frame(int c) { return (double)m_shortFrame[c]; }
-
 private:
-    LPCTSTR m_wave;
-    CWaveIn* m_wavein;
+    void ReadWaveFrame(float* frame);
+    bool IsSourceDone();
+    void StopStreaming();
+    double Envelope();
+
+    CSampleBufferPtr m_wave;    //!< The wave we play, shared with other voices
+    int m_position;             //!< Next frame of the wave to play
     double m_loopStart;
     double m_loopEnd;
     CSineWave   m_sinewave;
@@ -37,8 +40,11 @@ private:
     double m_attack;
     double m_release;
     double m_pitch;
-
-    short m_shortFrame[];
+    int m_loopStartFrame;       //!< Loop start in wave frames
+    int m_loopEndFrame;         //!< Loop end in wave frames
+    CSampleStreamer* m_streamer;
+    CStreamCursor* m_cursor;    //!< Frames past the head of a streamed wave
+    bool m_streaming;           //!< Are we playing from m_cursor?
 public:
 
     CWavetableInstrument();
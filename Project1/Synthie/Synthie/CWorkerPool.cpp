@@ -0,0 +1,186 @@
+#include "pch.h"
+#include "CWorkerPool.h"
+
+CWorkerPool::CWorkerPool()
+{
+    m_numThreads = 1;
+    m_maxTasks = 0;
+    m_batch = 0;
+    m_quit = false;
+    m_remaining = 0;
+
+    m_queues.push_back(std::unique_ptr<Queue>(new Queue));
+    m_queues[0]->front = m_queues[0]->back = 0;
+}
+
+CWorkerPool::~CWorkerPool()
+{
+    Stop();
+}
+
+void CWorkerPool::SetNumThreads(int threads)
+{
+    if (threads < 1)
+        threads = 1;
+
+    if (threads == m_numThreads && (int)m_threads.size() == threads - 1)
+        return;
+
+    Stop();
+
+    m_numThreads = threads;
+    m_queues.clear();
+    for (int w = 0; w < threads; w++)
+    {
+        m_queues.push_back(std::unique_ptr<Queue>(new Queue));
+        m_queues[w]->tasks.resize(m_maxTasks);
+        m_queues[w]->front = m_queues[w]->back = 0;
+    }
+
+    // Worker 0 is whoever calls Run(), so start one less thread
+    m_quit = false;
+    for (int w = 1; w < threads; w++)
+    {
+        m_threads.push_back(std::thread(&CWorkerPool::ThreadLoop, this, w));
+    }
+}
+
+void CWorkerPool::SetMaxTasks(int tasks)
+{
+    m_maxTasks = tasks;
+    for (size_t w = 0; w < m_queues.size(); w++)
+    {
+        std::lock_guard<std::mutex> lock(m_queues[w]->mutex);
+        m_queues[w]->tasks.resize(tasks);
+    }
+}
+
+void CWorkerPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+
+    m_wake.notify_all();
+
+    for (size_t i = 0; i < m_threads.size(); i++)
+        m_threads[i].join();
+
+    m_threads.clear();
+}
+
+//
+// Name :        CWorkerPool::Run()
+// Description : Run a batch of tasks on the pool and wait for it to 
+//               finish. Tasks are dealt round robin so every worker 
+//               starts with its own share, stealing only to balance
+//               out the end of the batch.
+//
+
+void CWorkerPool::Run(int tasks, const std::function<void(int, int)>& task)
+{
+    if (tasks > m_maxTasks)
+        SetMaxTasks(tasks);
+
+    if (m_numThreads == 1 || tasks == 1)
+    {
+        for (int t = 0; t < tasks; t++)
+            task(t, 0);
+
+        return;
+    }
+
+    m_task = task;
+    m_remaining = tasks;
+
+    for (int w = 0; w < m_numThreads; w++)
+    {
+        Queue& queue = *m_queues[w];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        queue.front = queue.back = 0;
+        for (int t = w; t < tasks; t += m_numThreads)
+            queue.tasks[queue.back++] = t;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_batch++;
+    }
+
+    m_wake.notify_all();
+
+    // The caller is worker 0
+    Work(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_remaining == 0; });
+}
+
+void CWorkerPool::ThreadLoop(int worker)
+{
+    unsigned seen = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this, seen] { return m_quit || m_batch != seen; });
+            if (m_quit)
+                break;
+
+            seen = m_batch;
+        }
+
+        Work(worker);
+    }
+}
+
+//
+// Run tasks until there are none left to take anywhere
+//
+
+void CWorkerPool::Work(int worker)
+{
+    int task;
+    while (Pop(worker, task) || Steal(worker, task))
+    {
+        m_task(task, worker);
+
+        if (--m_remaining == 0)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done.notify_all();
+        }
+    }
+}
+
+bool CWorkerPool::Pop(int worker, int& task)
+{
+    Queue& queue = *m_queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (queue.back == queue.front)
+        return false;
+
+    task = queue.tasks[--queue.back];
+    return true;
+}
+
+bool CWorkerPool::Steal(int worker, int& task)
+{
+    for (int i = 1; i < m_numThreads; i++)
+    {
+        Queue& queue = *m_queues[(worker + i) % m_numThreads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (queue.back != queue.front)
+        {
+            task = queue.tasks[queue.front++];
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Pool of worker threads that run batches of tasks
+/*! Run() deals the task numbers of a batch out across one deque per
+ *  worker. A worker pops tasks from the back of its own deque and,
+ *  once that is empty, steals from the front of the others. Each
+ *  deque is guarded by its own mutex, held only to take one task; a
+ *  task is meant to be big enough that the lock is rarely contended.
+ *  The calling thread joins in as worker 0, so a pool of one thread
+ *  runs everything inline.
+ */
+class CWorkerPool
+{
+public:
+    CWorkerPool();
+    virtual ~CWorkerPool();
+
+    //! Set the number of threads, including the caller of Run()
+    void SetNumThreads(int threads);
+
+    //! Number of threads, including the caller of Run()
+    int GetNumThreads() const { return m_numThreads; }
+
+    //! Set the most tasks a single batch can have
+    void SetMaxTasks(int tasks);
+
+    //! Run task(t, worker) for t = 0 .. tasks-1 and wait for them all
+    void Run(int tasks, const std::function<void(int, int)>& task);
+
+private:
+    //! One worker's deque of task numbers
+    struct Queue
+    {
+        std::mutex  mutex;
+        std::vector<int> tasks;     //!< Preallocated to the most tasks
+        int         front;          //!< Thieves take from here
+        int         back;           //!< The owner takes from here
+    };
+
+    void Stop();
+    void ThreadLoop(int worker);
+    void Work(int worker);
+    bool Pop(int worker, int& task);
+    bool Steal(int worker, int& task);
+
+    int m_numThreads;
+    int m_maxTasks;
+    std::vector<std::thread> m_threads;
+    std::vector<std::unique_ptr<Queue> > m_queues;
+    std::function<void(int, int)> m_task;
+
+    std::mutex  m_mutex;
+    std::condition_variable m_wake;     //!< A batch is ready, or we are quitting
+    std::condition_variable m_done;     //!< The batch has finished
+    unsigned    m_batch;                //!< Counts batches so workers can spot a new one
+    bool        m_quit;
+    std::atomic<int> m_remaining;       //!< Tasks of the batch not yet finished
+};
@@ -1,28 +1,17 @@
 #include "pch.h"
 #include "Notes.h"
-#include <map>
-#include <string>
 
-using namespace std;
-
-static int g_initialized = false;
-static map<wstring, double> g_name2freq;
-
-double NoteToFrequency(const WCHAR *name)
-{
-    if(!g_initialized)
-    {
-        for(int i=0;  i<sizeof(notes) / sizeof(Notes);  i++)
-        {
-            g_name2freq[notes[i].name] = notes[i].freq;
-        }
-
-        g_initialized = true;
-    }
-
-    map<wstring, double>::iterator f = g_name2freq.find(name);
-    if(f == g_name2freq.end())
-        return 0;
-
-    return f->second;
-}
\ No newline at end of file
+// The parser runs at compile time, so check it there
+static_assert(ParseNoteName("A4").pitch == 69, "A4 is MIDI 69");
+static_assert(ParseNoteName("C4").pitch == 60, "C4 is middle C");
+static_assert(ParseNoteName("Bb0").pitch == ParseNoteName("A#0").pitch, "Flats and sharps");
+static_assert(ParseNoteName("C-1").pitch == 0, "Octave -1");
+static_assert(ParseNoteName("G9").pitch == 127, "The highest pitch");
+static_assert(ParseNoteName("G#9").pitch == -1, "Above the highest pitch");
+static_assert(ParseNoteName("C10").pitch == -1 && ParseNoteName("C99999999999").pitch == -1 &&
+    ParseNoteName("C-99999999999").pitch == -1, "Octaves past 9");
+static_assert(ParseNoteName("E4+12.5").cents == 12.5, "Cents");
+static_assert(ParseNoteName("E4-25").cents == -25, "Negative cents");
+static_assert(ParseNoteName(L"F#3").pitch == 54, "Wide names");
+static_assert(ParseNoteName("H4").pitch == -1 && ParseNoteName("C").pitch == -1 && ParseNoteName("C4x").pitch == -1,
+    "Not notes");
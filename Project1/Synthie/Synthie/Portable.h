@@ -0,0 +1,25 @@
+// Portable.h : stand-ins for the handful of Windows types the
+// synthesizer core uses, for headless builds without MFC.
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// The MFC build is Unicode, so the core works in wide characters
+// everywhere.  We do the same without Windows.
+typedef wchar_t WCHAR;
+typedef wchar_t TCHAR;
+typedef const TCHAR* LPCTSTR;
+typedef unsigned int UINT;
+
+#ifndef TEXT
+#define TEXT(s) L##s
+#endif
+
+#ifndef NULL
+#define NULL 0
+#endif
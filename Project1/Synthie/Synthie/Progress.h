@@ -16,6 +16,7 @@ class CProgress
 public:
 	void ProgressEnd(CWnd *p_view);
 	bool ProgressAbortCheck() {return m_progressdlg.Abort();}
+	void ProgressSet(double p_fraction) {m_progressdlg.SetProgress(p_fraction);}
 	void ProgressBegin(CWnd *p_view);
 	CProgress();
 	virtual ~CProgress();
@@ -28,6 +28,7 @@ void CProgressDlg::DoDataExchange(CDataExchange* pDX)
 {
 	CDialog::DoDataExchange(pDX);
 	//{{AFX_DATA_MAP(CProgressDlg)
+	DDX_Control(pDX, IDC_PROGRESS, m_progress);
 	//}}AFX_DATA_MAP
 }
 
@@ -46,6 +47,20 @@ void CProgressDlg::OnStop()
    m_abort = true;	
 }
 
+//
+// Name :         CProgressDlg::SetProgress()
+// Description :  Show how far along we are, 0 to 1.
+//
+
+void CProgressDlg::SetProgress(double p_fraction)
+{
+   if(m_progress.GetSafeHwnd() == NULL)
+      return;
+
+   m_progress.SetRange(0, 1000);
+   m_progress.SetPos(int(p_fraction * 1000));
+}
+
 bool CProgressDlg::Abort()
 {
    // Allow any messages to be processed
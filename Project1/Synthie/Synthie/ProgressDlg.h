@@ -18,10 +18,12 @@ public:
 
 	bool Abort();
    void AbortClear() {m_abort = false;}
+   void SetProgress(double p_fraction);
 
 // Dialog Data
 	//{{AFX_DATA(CProgressDlg)
 	enum { IDD = IDD_PROGRESS_DLG };
+	CProgressCtrl	m_progress;
 	//}}AFX_DATA
 
 
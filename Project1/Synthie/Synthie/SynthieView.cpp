@@ -6,11 +6,18 @@
 #include "Synthie.h"
 #include "SynthieView.h"
 #include <cmath>
+#include <vector>
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
 #endif
 
+// Milliseconds between checks on the progress dialog while rendering
+const int ProgressInterval = 50;
+
+// Most voices played at once when the output is the speakers
+const int RealtimePolyphony = 256;
+
 short RangeBound(double d)
 {
     if(d < -32768)
@@ -156,6 +163,38 @@ void CSynthieView::GenerateWriteFrame(short *p_frame)
 }
 
 
+//
+// Name :        CSynthieView::GenerateWriteBlock()
+// Description : Write a block of float frames to the current generation
+//               device.  The file gets the whole block at once and
+//               writes it on its own thread.
+//
+
+void CSynthieView::GenerateWriteBlock(const float *p_block, int frames)
+{
+    short audio[2 * 1024];
+
+    for (int start = 0; start < frames; start += 1024)
+    {
+        int n = frames - start < 1024 ? frames - start : 1024;
+
+        for (int i = 0; i < n; i++)
+        {
+            audio[i * 2] = RangeBound(p_block[(start + i) * 2] * 32767);
+            audio[i * 2 + 1] = RangeBound(p_block[(start + i) * 2 + 1] * 32767);
+        }
+
+        m_waveformBuffer.Frames(audio, n);
+
+        if(m_audiooutput)
+            m_soundstream.WriteFrames(audio, n);
+    }
+
+    if(m_fileoutput)
+        m_wave.WriteFrames(p_block, frames);
+}
+
+
 //
 // Name :        CSynthieView::GenerateEnd()
 // Description : End the generation process.
@@ -227,22 +266,42 @@ void CSynthieView::OnGenerateSynthesizer()
 	if (!GenerateBegin())
 		return;
 
-	m_synthesizer.Start();
-	short audio[2];
-	double frame[2];
+	// Playing to the speakers has a deadline, so bound the cost of a
+	// block by bounding the voices.  Rendering only to a file plays them all.
+	m_synthesizer.SetMaxPolyphony(m_audiooutput ? RealtimePolyphony : 0);
 
-	while (m_synthesizer.Generate(frame))
-	{
-		audio[0] = RangeBound(frame[0] * 32767);
-		audio[1] = RangeBound(frame[1] * 32767);
+	// Synthesis runs on its own thread.  This thread hands the blocks
+	// it renders to the outputs and keeps the progress dialog going.
+	m_render.Start(&m_synthesizer);
 
-		GenerateWriteFrame(audio);
+	std::vector<float> block(m_render.BlockSize() * NumChannels());
+	DWORD lastCheck = GetTickCount();
 
-		// The progress control
-		if (ProgressAbortCheck())
+	for (;;)
+	{
+		int frames = m_render.Pop(&block[0], ProgressInterval);
+		if (frames == 0)
 			break;
+
+		if (frames > 0)
+			GenerateWriteBlock(&block[0], frames);
+
+		// The progress control, a few times a second rather than every block
+		if (frames < 0 || GetTickCount() - lastCheck >= ProgressInterval)
+		{
+			lastCheck = GetTickCount();
+			ProgressSet(m_render.Progress());
+
+			if (ProgressAbortCheck())
+			{
+				m_render.Cancel();
+				break;
+			}
+		}
 	}
 
+	m_render.Stop();
+
 	// Call to close the generator output
 	GenerateEnd();
 }
@@ -255,7 +314,8 @@ void CSynthieView::OnFileOpenscore()
 	if (dlg.DoModal() != IDOK)
 		return;
 
-	m_synthesizer.OpenScore(dlg.GetPathName());
+	if (!m_synthesizer.OpenScore(dlg.GetPathName()))
+		AfxMessageBox(m_synthesizer.GetError().c_str());
 }
 
 void CSynthieView::OnFileLoadwavforwavetable()
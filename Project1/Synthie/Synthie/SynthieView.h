@@ -10,6 +10,7 @@
 #include "audio/DirSoundStream.h"	// Added by ClassView
 #include "audio/WaveformBuffer.h"
 #include <CSynthesizer.h>
+#include <CRenderThread.h>
 
 
 // CSynthieView window
@@ -43,6 +44,7 @@ private:
 	bool m_fileoutput;
 	bool m_audiooutput;
 	void GenerateWriteFrame(short *p_frame);
+	void GenerateWriteBlock(const float *p_block, int frames);
 	bool OpenGenerateFile(CWaveOut &p_wave);
 	void GenerateEnd();
 	bool GenerateBegin();
@@ -62,6 +64,7 @@ public:
 	afx_msg void OnGenerate1000hztone();
 private:
 	CSynthesizer m_synthesizer;
+	CRenderThread m_render;		// Runs m_synthesizer for OnGenerateSynthesizer()
 public:
 	afx_msg void OnGenerateSynthesizer();
 	afx_msg void OnFileOpenscore();
@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "Utf8.h"
+
+std::wstring Utf8ToWide(const char* text, size_t length)
+{
+    std::wstring result;
+    result.reserve(length);
+
+    const unsigned char* p = (const unsigned char*)text;
+    const unsigned char* end = p + length;
+
+    while (p < end)
+    {
+        unsigned long code = *p++;
+        int more = 0;
+
+        if (code >= 0xf0) { code &= 0x07; more = 3; }
+        else if (code >= 0xe0) { code &= 0x0f; more = 2; }
+        else if (code >= 0xc0) { code &= 0x1f; more = 1; }
+
+        for (; more > 0 && p < end; more--)
+            code = (code << 6) | (*p++ & 0x3f);
+
+        if (sizeof(wchar_t) == 2 && code >= 0x10000)
+        {
+            // Surrogate pair for 16 bit wchar_t (Windows)
+            code -= 0x10000;
+            result += wchar_t(0xd800 + (code >> 10));
+            result += wchar_t(0xdc00 + (code & 0x3ff));
+        }
+        else
+        {
+            result += wchar_t(code);
+        }
+    }
+
+    return result;
+}
+
+std::string WideToUtf8(const wchar_t* text)
+{
+    std::string result;
+
+    for (; *text != 0; text++)
+    {
+        unsigned long code = (unsigned long)*text;
+
+        if (sizeof(wchar_t) == 2 && code >= 0xd800 && code < 0xdc00 && text[1] != 0)
+        {
+            // Recombine a surrogate pair
+            text++;
+            code = 0x10000 + ((code - 0xd800) << 10) + ((unsigned long)*text - 0xdc00);
+        }
+
+        AppendUtf8(result, code);
+    }
+
+    return result;
+}
+
+void AppendUtf8(std::string& text, unsigned long code)
+{
+    if (code < 0x80)
+    {
+        text += char(code);
+    }
+    else if (code < 0x800)
+    {
+        text += char(0xc0 | (code >> 6));
+        text += char(0x80 | (code & 0x3f));
+    }
+    else if (code < 0x10000)
+    {
+        text += char(0xe0 | (code >> 12));
+        text += char(0x80 | ((code >> 6) & 0x3f));
+        text += char(0x80 | (code & 0x3f));
+    }
+    else
+    {
+        text += char(0xf0 | (code >> 18));
+        text += char(0x80 | ((code >> 12) & 0x3f));
+        text += char(0x80 | ((code >> 6) & 0x3f));
+        text += char(0x80 | (code & 0x3f));
+    }
+}
@@ -0,0 +1,16 @@
+// Utf8.h : conversions between UTF-8 and the wide strings the 
+// synthesizer uses for names and paths.
+//
+
+#pragma once
+
+#include <string>
+
+//! Convert UTF-8 text to a wide string
+std::wstring Utf8ToWide(const char* text, size_t length);
+
+//! Convert a wide string to UTF-8
+std::string WideToUtf8(const wchar_t* text);
+
+//! Append one Unicode code point to UTF-8 text
+void AppendUtf8(std::string& text, unsigned long code);
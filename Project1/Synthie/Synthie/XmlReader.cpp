@@ -0,0 +1,500 @@
+//
+// Name :         XmlReader.cpp
+// Description :  A small, portable streaming XML reader.  It handles
+//                what .score files use: elements, attributes, comments,
+//                processing instructions, and the standard character
+//                entities.
+//
+
+#include "pch.h"
+#include "XmlReader.h"
+#include "Utf8.h"
+#include <algorithm>
+#include <sstream>
+
+using namespace std;
+
+// Bytes read from the file at a time
+const size_t ChunkSize = 65536;
+
+CXmlReader::CXmlReader()
+{
+    m_text = "";
+    Reset();
+}
+
+void CXmlReader::Reset()
+{
+    m_pos = 0;
+    m_length = 0;
+    m_line = 1;
+    m_depth = 0;
+    m_emptyElement = false;
+    m_name.clear();
+    m_open.clear();
+    m_attributeText.clear();
+    m_attributes.clear();
+    m_error.clear();
+}
+
+bool CXmlReader::Open(LPCTSTR filename, wstring& error)
+{
+    if (m_file.is_open())
+        m_file.close();
+    m_file.clear();
+
+#ifdef SYNTHIE_HEADLESS
+    m_file.open(WideToUtf8(filename).c_str(), ios::binary);
+#else
+    m_file.open(filename, ios::binary);
+#endif
+
+    if (!m_file)
+    {
+        error = wstring(L"Unable to open ") + filename;
+        return false;
+    }
+
+    m_buffer.resize(ChunkSize);
+    m_text = &m_buffer[0];
+    Reset();
+
+    // Skip a UTF-8 byte order mark
+    if (Ensure(3) && Starts("\xEF\xBB\xBF"))
+        m_pos += 3;
+
+    return true;
+}
+
+void CXmlReader::SetText(const char* text, size_t length)
+{
+    if (m_file.is_open())
+        m_file.close();
+
+    m_text = text;
+    Reset();
+    m_length = length;
+
+    if (Starts("\xEF\xBB\xBF"))
+        m_pos += 3;
+}
+
+//
+// Name :        CXmlReader::Next()
+// Description : Skip text, comments, and the like up to the next tag
+//               and report it.
+//
+
+CXmlReader::Event CXmlReader::Next()
+{
+    if (m_emptyElement)
+    {
+        // The end of <a/>, whose name is still in m_name
+        m_emptyElement = false;
+        m_depth = (int)m_open.size();
+        m_open.pop_back();
+        m_attributes.clear();
+        return EndElement;
+    }
+
+    while (true)
+    {
+        // Text between elements is not used
+        while (true)
+        {
+            const char* p = m_text + m_pos;
+            const char* lt = (const char*)memchr(p, '<', m_length - m_pos);
+            if (lt != NULL)
+            {
+                Advance(lt - p);
+                break;
+            }
+
+            Advance(m_length - m_pos);
+            if (!Refill())
+            {
+                if (!m_open.empty())
+                {
+                    Fail(L"Missing closing tag");
+                    return Error;
+                }
+
+                return EndDocument;
+            }
+        }
+
+        // Enough to tell what kind of tag this is
+        Ensure(9);
+
+        if (Starts("<!--"))
+        {
+            if (!SkipPast("-->"))
+            {
+                Fail(L"Unterminated comment");
+                return Error;
+            }
+        }
+        else if (Starts("<?"))
+        {
+            if (!SkipPast("?>"))
+            {
+                Fail(L"Unterminated processing instruction");
+                return Error;
+            }
+        }
+        else if (Starts("<![CDATA["))
+        {
+            if (!SkipPast("]]>"))
+            {
+                Fail(L"Unterminated CDATA section");
+                return Error;
+            }
+        }
+        else if (Starts("<!"))
+        {
+            if (!SkipPast(">"))
+            {
+                Fail(L"Unterminated declaration");
+                return Error;
+            }
+        }
+        else
+        {
+            size_t end;
+            if (!FindTagEnd(end))
+            {
+                Fail(L"Unterminated element");
+                return Error;
+            }
+
+            if (Starts("</"))
+                return ParseEndTag(end) ? EndElement : Error;
+
+            return ParseStartTag(end) ? StartElement : Error;
+        }
+    }
+}
+
+//
+// Name :        CXmlReader::Refill()
+// Description : Move what is left of the buffer to its start and read
+//               more of the file after it.  The buffer only grows if a
+//               single tag does not fit.
+// Returns :     false if there was nothing more to read.
+//
+
+bool CXmlReader::Refill()
+{
+    if (!m_file.is_open())
+        return false;
+
+    size_t keep = m_length - m_pos;
+    if (m_pos > 0)
+        memmove(&m_buffer[0], &m_buffer[m_pos], keep);
+
+    m_pos = 0;
+    m_length = keep;
+
+    if (m_length == m_buffer.size())
+        m_buffer.resize(m_buffer.size() * 2);
+
+    m_text = &m_buffer[0];
+
+    m_file.read(&m_buffer[m_length], m_buffer.size() - m_length);
+    size_t read = (size_t)m_file.gcount();
+    m_length += read;
+
+    return read > 0;
+}
+
+bool CXmlReader::Ensure(size_t length)
+{
+    while (m_length - m_pos < length)
+    {
+        if (!Refill())
+            return false;
+    }
+
+    return true;
+}
+
+//
+// Name :        CXmlReader::FindTagEnd()
+// Description : Find the > that ends the tag at m_pos, reading more of
+//               the file until it is in the buffer.  A > inside a
+//               quoted attribute value does not count.
+//
+
+bool CXmlReader::FindTagEnd(size_t& end)
+{
+    size_t i = 1;
+    char quote = 0;
+
+    while (true)
+    {
+        for (; m_pos + i < m_length; i++)
+        {
+            char c = m_text[m_pos + i];
+            if (quote != 0)
+            {
+                if (c == quote)
+                    quote = 0;
+            }
+            else if (c == '"' || c == '\'')
+            {
+                quote = c;
+            }
+            else if (c == '>')
+            {
+                end = m_pos + i;
+                return true;
+            }
+        }
+
+        if (!Refill())
+            return false;
+    }
+}
+
+bool CXmlReader::SkipPast(const char* marker)
+{
+    size_t len = strlen(marker);
+    size_t i = 0;
+
+    while (true)
+    {
+        for (; m_pos + i + len <= m_length; i++)
+        {
+            if (memcmp(m_text + m_pos + i, marker, len) == 0)
+            {
+                Advance(i + len);
+                return true;
+            }
+        }
+
+        if (!Refill())
+        {
+            Advance(m_length - m_pos);
+            return false;
+        }
+    }
+}
+
+//
+// Name :        CXmlReader::ParseStartTag()
+// Description : Parse the element name and attributes of the start
+//               tag from m_pos to the > at end.
+//
+
+bool CXmlReader::ParseStartTag(size_t end)
+{
+    const char* p = m_text + m_pos + 1;
+    const char* e = m_text + end;
+
+    m_name.clear();
+    if (!ParseName(p, e, m_name))
+        return Fail(L"Expected an element name");
+
+    m_attributeText.clear();
+    m_attributes.clear();
+
+    bool empty = false;
+    while (true)
+    {
+        while (p < e && IsSpace(*p))
+            p++;
+
+        if (p == e)
+            break;
+
+        if (*p == '/' && p + 1 == e)
+        {
+            empty = true;
+            break;
+        }
+
+        size_t name = m_attributeText.size();
+        if (!ParseName(p, e, m_attributeText))
+            return Fail(L"Expected an attribute name");
+        m_attributeText += '\0';
+
+        while (p < e && IsSpace(*p))
+            p++;
+        if (p == e || *p != '=')
+            return Fail(L"Expected = after attribute name");
+        p++;
+        while (p < e && IsSpace(*p))
+            p++;
+
+        size_t value = m_attributeText.size();
+        if (!ParseAttributeValue(p, e))
+            return false;
+        m_attributeText += '\0';
+
+        m_attributes.push_back(make_pair(name, value));
+    }
+
+    Advance(end + 1 - m_pos);
+
+    m_open.push_back(m_name);
+    m_depth = (int)m_open.size();
+    m_emptyElement = empty;
+    return true;
+}
+
+bool CXmlReader::ParseEndTag(size_t end)
+{
+    const char* p = m_text + m_pos + 2;
+    const char* e = m_text + end;
+
+    m_attributes.clear();
+
+    m_name.clear();
+    if (!ParseName(p, e, m_name))
+        return Fail(L"Mismatched closing tag");
+
+    while (p < e && IsSpace(*p))
+        p++;
+    if (p != e)
+        return Fail(L"Expected > to end the closing tag");
+
+    if (m_open.empty())
+        return Fail(L"Unexpected closing tag");
+    if (m_open.back() != m_name)
+        return Fail(L"Mismatched closing tag");
+
+    Advance(end + 1 - m_pos);
+
+    m_depth = (int)m_open.size();
+    m_open.pop_back();
+    return true;
+}
+
+//
+// Append the name at p to name
+//
+
+bool CXmlReader::ParseName(const char*& p, const char* end, string& name)
+{
+    const char* start = p;
+    while (p < end && IsNameChar(*p))
+        p++;
+
+    if (p == start)
+        return false;
+
+    name.append(start, p);
+    return true;
+}
+
+//
+// Append a quoted attribute value, with character entities
+// replaced, to m_attributeText
+//
+
+bool CXmlReader::ParseAttributeValue(const char*& p, const char* end)
+{
+    if (p >= end || (*p != '"' && *p != '\''))
+        return Fail(L"Expected a quoted attribute value");
+
+    char quote = *p++;
+
+    while (p < end && *p != quote)
+    {
+        if (*p != '&')
+        {
+            const char* start = p;
+            while (p < end && *p != quote && *p != '&')
+                p++;
+
+            m_attributeText.append(start, p);
+            continue;
+        }
+
+        const char* semi = p;
+        while (semi < end && *semi != ';' && *semi != quote)
+            semi++;
+
+        if (semi >= end || *semi != ';')
+            return Fail(L"Unterminated character reference");
+
+        string entity(p + 1, semi);
+        p = semi + 1;
+
+        if (entity == "lt") m_attributeText += '<';
+        else if (entity == "gt") m_attributeText += '>';
+        else if (entity == "amp") m_attributeText += '&';
+        else if (entity == "quot") m_attributeText += '"';
+        else if (entity == "apos") m_attributeText += '\'';
+        else if (entity.size() > 1 && entity[0] == '#')
+        {
+            // Every character after # or #x must be a digit, and the
+            // code must be a character XML allows
+            bool hex = entity[1] == 'x';
+            size_t i = hex ? 2 : 1;
+            unsigned long code = 0;
+            bool ok = i < entity.size();
+
+            for (; ok && i < entity.size(); i++)
+            {
+                char c = entity[i];
+                int digit = c >= '0' && c <= '9' ? c - '0' :
+                    hex && c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+                    hex && c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+
+                code = code * (hex ? 16 : 10) + digit;
+                ok = digit >= 0 && code <= 0x10ffff;
+            }
+
+            if (!ok || code == 0 || (code >= 0xd800 && code < 0xe000))
+                return Fail(L"Bad character reference");
+
+            // Store it as UTF-8 with the rest of the value
+            AppendUtf8(m_attributeText, code);
+        }
+        else
+        {
+            return Fail(L"Unknown character reference");
+        }
+    }
+
+    if (p >= end)
+        return Fail(L"Unterminated attribute value");
+
+    p++;        // The closing quote
+    return true;
+}
+
+//
+// Move past length characters, counting the lines
+//
+
+void CXmlReader::Advance(size_t length)
+{
+    m_line += (int)count(m_text + m_pos, m_text + m_pos + length, '\n');
+    m_pos += length;
+}
+
+bool CXmlReader::Starts(const char* s) const
+{
+    size_t len = strlen(s);
+    return m_length - m_pos >= len && memcmp(m_text + m_pos, s, len) == 0;
+}
+
+bool CXmlReader::IsNameChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+        c == '_' || c == '-' || c == '.' || c == ':' || (c & 0x80) != 0;
+}
+
+//
+// Record an error message, with the line number it happened on
+//
+
+bool CXmlReader::Fail(const wchar_t* message)
+{
+    wostringstream str;
+    str << message << L" on line " << m_line;
+    m_error = str.str();
+    return false;
+}
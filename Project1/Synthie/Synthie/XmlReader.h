@@ -0,0 +1,86 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+//! A streaming XML reader
+/*! A small portable pull parser, enough to read .score files. Each
+ *  call to Next() reads up to the next element start or end tag and
+ *  reports it, so a score is loaded in one pass with no tree in
+ *  memory. Files are read a chunk at a time; only the current tag has
+ *  to fit in the buffer. Text, comments, and processing instructions
+ *  are skipped. Names and attribute values are UTF-8, with character
+ *  entities replaced, and stay valid until the next call to Next().
+ */
+class CXmlReader
+{
+public:
+    enum Event { StartElement, EndElement, EndDocument, Error };
+
+    CXmlReader();
+
+    //! Read an XML file
+    /*! Returns false with a message in error if it cannot be opened */
+    bool Open(LPCTSTR filename, std::wstring& error);
+
+    //! Read UTF-8 XML text held in memory, which must outlive the reader
+    void SetText(const char* text, size_t length);
+
+    //! Read to the next element start or end
+    /*! An empty element, <a/>, is reported as a start and an end */
+    Event Next();
+
+    //! Why Next() returned Error
+    const std::wstring& GetError() const { return m_error; }
+
+    //! Name of the element started or ended
+    const std::string& Name() const { return m_name; }
+
+    //! Depth of the element started or ended, 1 for the top level
+    int Depth() const { return m_depth; }
+
+    //! Number of attributes on the element just started
+    int NumAttributes() const { return (int)m_attributes.size(); }
+
+    //! Name of attribute i
+    const char* AttributeName(int i) const { return m_attributeText.c_str() + m_attributes[i].first; }
+
+    //! Value of attribute i
+    const char* AttributeValue(int i) const { return m_attributeText.c_str() + m_attributes[i].second; }
+
+private:
+    void Reset();
+    bool Refill();
+    bool Ensure(size_t length);
+    bool FindTagEnd(size_t& end);
+    bool SkipPast(const char* marker);
+    bool ParseStartTag(size_t end);
+    bool ParseEndTag(size_t end);
+    bool ParseName(const char*& p, const char* end, std::string& name);
+    bool ParseAttributeValue(const char*& p, const char* end);
+    void Advance(size_t length);
+    bool Starts(const char* s) const;
+    bool Fail(const wchar_t* message);
+
+    static bool IsNameChar(char c);
+    static bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    std::ifstream     m_file;
+    std::vector<char> m_buffer;     //!< Text read from the file
+    const char* m_text;             //!< The text being read, from m_buffer or SetText()
+    size_t      m_pos;              //!< Where we are in m_text
+    size_t      m_length;           //!< Characters in m_text
+    int         m_line;             //!< Line m_pos is on, for errors
+
+    std::string m_name;
+    int         m_depth;
+    bool        m_emptyElement;     //!< The last start was <a/>, so its end is next
+    std::vector<std::string> m_open;    //!< Elements not yet closed
+
+    std::string m_attributeText;    //!< Attribute names and values, each ending in a 0
+    std::vector<std::pair<size_t, size_t> > m_attributes;  //!< Offsets of each name and value
+
+    std::wstring m_error;
+};
@@ -0,0 +1,97 @@
+/*
+ *  Name :         AudioRing.h
+ *  Description :  Lock-free single producer, single consumer ring of
+ *                 interleaved audio frames.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+/*! Ring buffer of interleaved 16 bit frames
+ *
+ * One thread writes and one other thread reads. Each side only moves
+ * its own position, so neither takes a lock. The capacity is rounded
+ * up to a power of two frames.
+ *
+ * The positions are stored sequentially consistent, so a side that
+ * publishes frames and then checks whether the other side is asleep
+ * cannot miss it (see CAudioStream).
+ */
+class CAudioRing
+{
+public:
+    CAudioRing() : m_channels(1), m_mask(0), m_write(0), m_read(0) {}
+
+    //! Size the ring for at least frames frames and empty it
+    void Allocate(int frames, int channels)
+    {
+        int size = 1;
+        while (size < frames)
+            size <<= 1;
+
+        m_channels = channels;
+        m_mask = size - 1;
+        m_data.assign(size_t(size) * channels, 0);
+        Clear();
+    }
+
+    //! Empty the ring. Only safe while neither side is using it.
+    void Clear() { m_write = 0; m_read = 0; }
+
+    //! Capacity in frames
+    int Capacity() const { return m_mask + 1; }
+
+    //! Frames waiting to be read
+    int Filled() const { return int(m_write.load() - m_read.load()); }
+
+    //! Frames there is room to write
+    int Space() const { return Capacity() - Filled(); }
+
+    //! Write up to frames frames, returning how many fit. Producer only.
+    int Write(const short* src, int frames)
+    {
+        long long write = m_write.load(std::memory_order_relaxed);
+        int space = Capacity() - int(write - m_read.load(std::memory_order_acquire));
+        if (frames > space)
+            frames = space;
+
+        Copy(&m_data[0], int(write & m_mask), src, frames);
+        m_write.store(write + frames);
+        return frames;
+    }
+
+    //! Read up to frames frames, returning how many there were. Consumer only.
+    int Read(short* dst, int frames)
+    {
+        long long read = m_read.load(std::memory_order_relaxed);
+        int filled = int(m_write.load(std::memory_order_acquire) - read);
+        if (frames > filled)
+            frames = filled;
+
+        // The frames wrap at most once
+        int start = int(read & m_mask);
+        int first = frames < Capacity() - start ? frames : Capacity() - start;
+        memcpy(dst, &m_data[size_t(start) * m_channels], size_t(first) * m_channels * sizeof(short));
+        memcpy(dst + size_t(first) * m_channels, &m_data[0], size_t(frames - first) * m_channels * sizeof(short));
+
+        m_read.store(read + frames);
+        return frames;
+    }
+
+private:
+    void Copy(short* ring, int start, const short* src, int frames)
+    {
+        int first = frames < Capacity() - start ? frames : Capacity() - start;
+        memcpy(ring + size_t(start) * m_channels, src, size_t(first) * m_channels * sizeof(short));
+        memcpy(ring, src + size_t(first) * m_channels, size_t(frames - first) * m_channels * sizeof(short));
+    }
+
+    int m_channels;
+    int m_mask;                         //!< Capacity - 1
+    std::vector<short> m_data;
+    std::atomic<long long> m_write;     //!< Frames written, ever
+    std::atomic<long long> m_read;      //!< Frames read, ever
+};
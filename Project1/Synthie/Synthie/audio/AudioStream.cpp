@@ -0,0 +1,231 @@
+/*
+ *  Name :         AudioStream.cpp
+ *  Description :  Portable base for streaming audio to an output device.
+ */
+
+#include "pch.h"
+
+#include <cstring>
+
+#include "AudioStream.h"
+
+
+CAudioStream::CAudioStream()
+{
+    m_samplerate = 44100;
+    m_numchannels = 2;
+    m_bufferduration = 0.5;
+    m_periodduration = 0.02;
+    m_periodframes = 0;
+    m_isopen = false;
+    m_draining = false;
+    m_quit = false;
+    m_started = false;
+    m_consumerWaiting = false;
+    m_played = 0;
+    m_underruns = 0;
+    m_maxqueued = 0;
+}
+
+CAudioStream::~CAudioStream()
+{
+}
+
+
+/*
+ *  Name :         CAudioStream::Open()
+ *  Description :  Open the device and start the thread that feeds it.
+ */
+
+bool CAudioStream::Open()
+{
+    if(m_isopen)
+        return false;
+
+    int period = int(m_periodduration * m_samplerate);
+    if(period < 1)
+        period = 1;
+
+    if(!OpenDevice(period))
+        return false;
+
+    m_periodframes = period;
+
+    int frames = int(m_bufferduration * m_samplerate);
+    m_ring.Allocate(frames > 2 * period ? frames : 2 * period, m_numchannels);
+    m_period.assign(size_t(period) * m_numchannels, 0);
+
+    m_draining = false;
+    m_quit = false;
+    m_started = false;
+    m_consumerWaiting = false;
+    m_played = 0;
+    m_underruns = 0;
+    m_maxqueued = 0;
+
+    m_isopen = true;
+    m_thread = std::thread(&CAudioStream::ThreadLoop, this);
+    return true;
+}
+
+
+/*
+ *  Name :         CAudioStream::Close()
+ *  Description :  Let everything written play out, then stop the
+ *                 device thread and close the device.
+ */
+
+bool CAudioStream::Close()
+{
+    if(!m_isopen)
+        return false;
+
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_draining = true;
+        m_cond.notify_all();
+
+        m_cond.wait(lock, [this] { return m_ring.Filled() == 0; });
+
+        // The last frames are in the device now
+        long long end = m_played + DeviceFrames() + m_periodframes;
+        m_cond.wait(lock, [this, end] { return m_played >= end; });
+
+        m_quit = true;
+    }
+
+    m_cond.notify_all();
+    WakeDevice();
+    m_thread.join();
+
+    CloseDevice();
+    m_isopen = false;
+    return true;
+}
+
+
+/*
+ *  Name :         CAudioStream::WriteFrames()
+ *  Description :  Queue interleaved frames for the device, sleeping
+ *                 while the ring is full.
+ */
+
+void CAudioStream::WriteFrames(const short *p_audio, int frames)
+{
+    if(!m_isopen)
+        return;
+
+    m_started = true;
+
+    for(;;)
+    {
+        int n = m_ring.Write(p_audio, frames);
+        p_audio += n * m_numchannels;
+        frames -= n;
+
+        // Only bother the device thread if it is waiting for us
+        if(m_consumerWaiting)
+        {
+            { std::lock_guard<std::mutex> lock(m_mutex); }
+            m_cond.notify_all();
+        }
+
+        if(frames == 0)
+            break;
+
+        WaitForSpace(frames);
+    }
+
+    int queued = m_ring.Filled();
+    if(queued > m_maxqueued)
+        m_maxqueued = queued;
+}
+
+
+/*
+ *  Name :         CAudioStream::WaitForSpace()
+ *  Description :  Sleep until the ring has room for frames, or at
+ *                 least a period of them.
+ */
+
+void CAudioStream::WaitForSpace(int frames)
+{
+    if(frames > m_periodframes)
+        frames = m_periodframes;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this, frames] { return m_ring.Space() >= frames || m_quit; });
+}
+
+
+/*
+ *  Name :         CAudioStream::WaitForData()
+ *  Description :  For devices that take frames whenever there are
+ *                 some.  The flag is set before the ring is checked, so
+ *                 a producer that writes in between sees it.
+ *  Returns :      false if the stream is being closed.
+ */
+
+bool CAudioStream::WaitForData(int frames)
+{
+    m_consumerWaiting = true;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cond.wait(lock, [this, frames] { return m_ring.Filled() >= frames || m_draining || m_quit; });
+
+    m_consumerWaiting = false;
+    return !m_quit;
+}
+
+
+/*
+ *  Name :         CAudioStream::ThreadLoop()
+ *  Description :  The device thread.  Hands the device a period from
+ *                 the ring each time it asks.
+ */
+
+void CAudioStream::ThreadLoop()
+{
+    ThreadStarted();
+
+    while(WaitDevice())
+    {
+        int n = m_ring.Read(&m_period[0], m_periodframes);
+        if(n < m_periodframes)
+        {
+            memset(&m_period[size_t(n) * m_numchannels], 0, size_t(m_periodframes - n) * m_numchannels * sizeof(short));
+
+            // Silence before the first write or while closing is expected
+            bool draining;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                draining = m_draining;
+            }
+
+            if(m_started && !draining)
+                m_underruns += m_periodframes - n;
+        }
+
+        PlayDevice(&m_period[0], m_periodframes);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_played += m_periodframes;
+        }
+
+        m_cond.notify_all();
+    }
+
+    ThreadStopped();
+}
+
+
+double CAudioStream::Latency() const
+{
+    return double(m_ring.Filled() + DeviceFrames()) / m_samplerate;
+}
+
+double CAudioStream::MaxLatency() const
+{
+    return double(m_maxqueued + DeviceFrames()) / m_samplerate;
+}
@@ -0,0 +1,114 @@
+/*
+ *  Name :         AudioStream.h
+ *  Description :  Portable base for streaming audio to an output device.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "AudioRing.h"
+
+/*! Audio output stream
+ *
+ * The producer calls WriteFrame() or WriteFrames(), which put frames
+ * into a lock-free ring. A device thread takes a period of frames out
+ * of the ring each time the device asks for one. Nobody polls: the
+ * producer only sleeps when the ring is full, and the device thread
+ * wakes it once per period. If the ring runs dry the device plays
+ * silence and the missing frames are counted as underruns.
+ *
+ * Derived classes supply the device. Their destructors must call
+ * Close(), since the device is gone by the time ours runs.
+ */
+class CAudioStream
+{
+public:
+    CAudioStream();
+    virtual ~CAudioStream();
+
+    bool Open();
+    bool Close();
+    bool IsOpen() const { return m_isopen; }
+
+    void WriteFrame(short *p_audio) { WriteFrames(p_audio, 1); }
+    void WriteFrames(const short *p_audio, int frames);
+
+    void SetChannels(int c) {m_numchannels = c;}
+    void SetSampleRate(int s) {m_samplerate = s;}
+
+    //! Seconds of audio the ring between the producer and the device holds
+    void SetBufferDuration(double d) {m_bufferduration = d;}
+
+    //! Seconds of audio the device asks for at a time
+    void SetPeriodDuration(double d) {m_periodduration = d;}
+
+    int GetChannels() const {return m_numchannels;}
+    int GetSampleRate() const {return m_samplerate;}
+    int PeriodFrames() const {return m_periodframes;}
+
+    //! Frames the device has played since Open(), its clock
+    long long FramesPlayed() const {return m_played;}
+
+    //! Frames of silence played because the producer fell behind
+    long long Underruns() const {return m_underruns;}
+
+    //! Seconds from a frame being written until it plays, right now
+    double Latency() const;
+
+    //! The most Latency() has been since Open()
+    double MaxLatency() const;
+
+protected:
+    //! Open the device. It may change the period it is asked for.
+    virtual bool OpenDevice(int &periodFrames) = 0;
+    virtual void CloseDevice() = 0;
+
+    //! Block until the device wants a period. Returns false to stop.
+    virtual bool WaitDevice() = 0;
+
+    //! Make a blocked WaitDevice() return false
+    virtual void WakeDevice() = 0;
+
+    //! Hand the device a period of frames
+    virtual void PlayDevice(const short *frames, int count) = 0;
+
+    //! Frames the device holds once they leave the ring
+    virtual int DeviceFrames() const {return m_periodframes;}
+
+    //! Called on the device thread as it starts and stops
+    virtual void ThreadStarted() {}
+    virtual void ThreadStopped() {}
+
+    //! Wait until the ring has frames frames, or we are closing
+    bool WaitForData(int frames);
+
+private:
+    void ThreadLoop();
+    void WaitForSpace(int frames);
+
+    int            m_samplerate;
+    int            m_numchannels;
+    double         m_bufferduration;
+    double         m_periodduration;
+    int            m_periodframes;
+    bool           m_isopen;
+
+    CAudioRing     m_ring;
+    std::vector<short> m_period;    // A period on its way to the device
+
+    std::thread    m_thread;
+    std::mutex     m_mutex;
+    std::condition_variable m_cond; // A period has played, or frames or a close arrived
+    bool           m_draining;      // Close() is waiting for the ring to play out
+    bool           m_quit;
+    std::atomic<bool> m_started;    // Has anything been written?
+    std::atomic<bool> m_consumerWaiting;    // Is WaitForData() asleep?
+    std::atomic<long long> m_played;
+    std::atomic<long long> m_underruns;
+    std::atomic<int> m_maxqueued;   // Most frames ever in the ring
+};
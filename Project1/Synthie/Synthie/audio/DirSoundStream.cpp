@@ -1,9 +1,11 @@
 //
 // Name :         DirSoundStream.cpp
 // Description :  Implementation of CDirSoundStream
-//                This class implements an MP-3 player that uses DirectShow and DirectSound
-//                to play an audio selection continuously, looping when done.  Full control 
-//                of the Pan position is available.
+//                This class streams audio to a DirectSound secondary buffer.  The
+//                buffer is split into DSNUMNOTIFY periods, and DirectSound signals
+//                an event each time the play cursor reaches one, so the thread in
+//                CAudioStream refills the period that just finished playing.  Full
+//                control of the Pan position is available.
 // Note :         There must be a single instantiation of CDirSound that is initialized.  A
 //                pointer to that object can be passed to a constructor, Open, or the
 //                SetDirSound function.
@@ -22,8 +24,6 @@ static char THIS_FILE[]=__FILE__;
 
 IMPLEMENT_DYNCREATE(CDirSoundStream, CObject)
 
-UINT CDirSoundStreamThreadProc( LPVOID pParam );
-
 
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
@@ -43,25 +43,24 @@ CDirSoundStream::CDirSoundStream(CDirSound *p_DirSound) : m_pDirSound(p_DirSound
 
 void CDirSoundStream::Initialize()
 {
-    m_isopen = false;
-    m_numchannels = 2;
-    m_samplerate = 44100;
-    m_audiocnt = 0;
-	m_bufferduration = 2.0;
+    m_periodbytes = 0;
+    m_fillperiod = 0;
+    m_quitevent = NULL;
+    for(int i=0;  i<DSNUMNOTIFY;  i++)
+        m_notify[i] = NULL;
 }
 
 
 CDirSoundStream::~CDirSoundStream()
 {
-    if(m_isopen)
-        Close();
+    Close();
 }
 
 //
 // Name :         CDirSoundStream::Open()
 // Description :  Open a stream for playback using DirectSound.
-//                This creates a secondary buffer and manages the 
-//                feeding of audio into that secondary buffer.
+//                This creates a secondary buffer and a thread that
+//                feeds audio into that secondary buffer.
 //
 
 bool CDirSoundStream::Open(CDirSound *p_DirSound)
@@ -72,27 +71,36 @@ bool CDirSoundStream::Open(CDirSound *p_DirSound)
     if(m_pDirSound == NULL)
         return false;
 
-    // Initialize the DirectSound system
-    if(!InitializeDirectSound())
-        return false;
-
-    m_isopen = TRUE;
-
-    // Ensure the event is reset before we start the thread
-    m_delaysync.ResetEvent();
-
-    // This class creates a thread for audio playback.  Begin the thread.
-    AfxBeginThread(CDirSoundStreamThreadProc, this, THREAD_PRIORITY_HIGHEST);
-
-    // Initially stopped until we get some data into it
-    m_pSoundBuffer->Stop();
-    m_bufferplaying = false;
+    return CAudioStream::Open();
+}
 
-    // And start the secondary buffer playing
-    // m_pSoundBuffer->Play(0, 0, DSBPLAY_LOOPING);
+//
+// Name :         CDirSoundStream::OpenDevice()
+// Description :  Create the secondary buffer and start it playing
+//                silence.  The stream thread takes over from there.
+//
 
-    m_threaddone.ResetEvent();
-    m_delaysync.SetEvent();
+bool CDirSoundStream::OpenDevice(int &periodFrames)
+{
+    if(!InitializeDirectSound(periodFrames))
+    {
+        CloseDevice();
+        return false;
+    }
+
+    short *pBuffer1;
+    DWORD size1;
+    short *pBuffer2;
+    DWORD size2;
+    if(m_pSoundBuffer->Lock(0, 0, (LPVOID *)(&pBuffer1), &size1, (LPVOID *)(&pBuffer2), &size2, DSBLOCK_ENTIREBUFFER) == DS_OK)
+    {
+        memset(pBuffer1, 0, size1);
+        m_pSoundBuffer->Unlock(pBuffer1, size1, pBuffer2, size2);
+    }
+
+    m_fillperiod = 0;
+    m_pSoundBuffer->SetCurrentPosition(0);
+    m_pSoundBuffer->Play(0, 0, DSBPLAY_LOOPING);
 
     return true;
 }
@@ -105,7 +113,7 @@ bool CDirSoundStream::Open(CDirSound *p_DirSound)
 //                of the secondary buffer.
 //
 
-bool CDirSoundStream::InitializeDirectSound()
+bool CDirSoundStream::InitializeDirectSound(int periodFrames)
 {
    //
    // Create a secondary buffer
@@ -120,10 +128,6 @@ bool CDirSoundStream::InitializeDirectSound()
             | DSBCAPS_CTRLPOSITIONNOTIFY  // Needed for notification
             | DSBCAPS_CTRLPAN             // Allow for panning
             | DSBCAPS_CTRLVOLUME;         // Allow volume control
- 
-   // The size of the buffer is arbitrary, but should be at least
-   // two seconds, to keep data writes well ahead of the play
-   // position.
 
    //
    // Set secondary buffer format
@@ -133,228 +137,174 @@ bool CDirSoundStream::InitializeDirectSound()
 
    memset(&wfx, 0, sizeof(WAVEFORMATEX)); 
    wfx.wFormatTag = WAVE_FORMAT_PCM; 
-   wfx.nChannels = m_numchannels; 
-   wfx.nSamplesPerSec = m_samplerate; 
+   wfx.nChannels = GetChannels(); 
+   wfx.nSamplesPerSec = GetSampleRate(); 
    wfx.wBitsPerSample = 16; 
    wfx.nBlockAlign = wfx.wBitsPerSample / 8 * wfx.nChannels;
    wfx.nAvgBytesPerSec = wfx.nSamplesPerSec * wfx.nBlockAlign;
 
-   m_buffersize = int(wfx.nAvgBytesPerSec * m_bufferduration); 
-   m_bufferwrloc = 0;
-   m_bufferrdloc = 0;
-   m_bufferfilled = 0;
+   // The buffer holds a period for each notification
+   m_periodbytes = periodFrames * wfx.nBlockAlign;
 
-   dsbdesc.dwBufferBytes = m_buffersize;
+   dsbdesc.dwBufferBytes = m_periodbytes * DSNUMNOTIFY;
    dsbdesc.lpwfxFormat = &wfx;
  
    if(m_pDirSound->DirectSound()->CreateSoundBuffer(&dsbdesc, &m_pSoundBuffer, NULL) != S_OK)
       return false;
 
-   return true;
-}
-
-
-//
-// Name :         CDirSoundStream::Close()
-// Description :  Close a currently open playback stream.
-//
-
-bool CDirSoundStream::Close()
-{
-   if(!m_isopen)
-      return false;
-
-   // Pad the end with 500ms of silence.
-   short silence[2] = {0, 0};
-   for(int i=0;  i<m_samplerate / 2;  i++)
-      WriteFrame(silence);
+   //
+   // An event for the start of each period, and one to stop the thread
+   //
 
-   // This ensures we will finish playing...
-   while(m_bufferplaying)
+   DSBPOSITIONNOTIFY positions[DSNUMNOTIFY];
+   for(int i=0;  i<DSNUMNOTIFY;  i++)
    {
-      Sleep(100);
+      m_notify[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+      positions[i].dwOffset = i * m_periodbytes;
+      positions[i].hEventNotify = m_notify[i];
    }
 
-   // Stop the playback
-   m_pSoundBuffer->Stop();
-
-   // End the thread
-   // I set the m_threadactive flag to false to end the loop in the thread.
-   // Then I set the notify events so it will immediately stop waiting
-   // for playback that will never end.  Finally, I wait for an event
-   // that signifies that the thread is done.
-   m_threadactive = false;
+   m_quitevent = CreateEvent(NULL, FALSE, FALSE, NULL);
 
-	CSingleLock dnlock(&m_threaddone);
-	dnlock.Lock();
-
-   // No more buffers needed.
-   m_pSoundBuffer.Release();
+   CComPtr<IDirectSoundNotify> pNotify;
+   if(m_pSoundBuffer->QueryInterface(IID_IDirectSoundNotify, (void **)&pNotify) != S_OK)
+      return false;
 
-   m_isopen = false;
+   if(pNotify->SetNotificationPositions(DSNUMNOTIFY, positions) != DS_OK)
+      return false;
 
    return true;
 }
 
 
 //
-// Name :        CDirSoundStream::WriteFrame()
-// Description : Write into the direct sound buffer.
+// Name :         CDirSoundStream::CloseDevice()
+// Description :  Stop playback and release the buffer and events.
 //
 
-void CDirSoundStream::WriteFrame(short *p_audio)
+void CDirSoundStream::CloseDevice()
 {
-   //
-   // I accumulate data into a small buffer so we 
-   // can move a larger chunk at a time to the 
-   // audio buffer.
-   //
-
-   if(m_numchannels == 2)
-   {
-      m_audio[m_audiocnt++] = p_audio[0];
-      m_audio[m_audiocnt++] = p_audio[1];
-   }
-   else
+   if(m_pSoundBuffer != NULL)
    {
-      m_audio[m_audiocnt++] = p_audio[0];
+      m_pSoundBuffer->Stop();
+      m_pSoundBuffer.Release();
    }
 
-   if(m_audiocnt >= 1996)
+   for(int i=0;  i<DSNUMNOTIFY;  i++)
    {
-      CSingleLock lock(&m_mutex);
-      lock.Lock();
-
-      // Do we have enough space to store this?
-      while((m_buffersize - m_bufferfilled) < (m_audiocnt * 2 + 5000))
-      {
-         lock.Unlock();
-         Sleep(250);
-         lock.Lock();
-      }
-
-      // We are ready to move a chunk of data, now.
-
-      short *pBuffer1;
-      DWORD size1;
-      short *pBuffer2;
-      DWORD size2;
-      m_pSoundBuffer->Lock(m_bufferwrloc, m_audiocnt * 2, (LPVOID *)(&pBuffer1), &size1, (LPVOID *)(&pBuffer2), &size2, 0);
-
-      memcpy(pBuffer1, (char *)m_audio, size1);
-      memcpy(pBuffer2, (char *)m_audio + size1, size2);
-      m_audiocnt = 0;
-
-      m_bufferwrloc = (m_bufferwrloc + size1 + size2) % m_buffersize;
-      m_bufferfilled += size1 + size2;
-
-      m_pSoundBuffer->Unlock(pBuffer1, size1, pBuffer2, size2);
-
-      if(!m_bufferplaying && m_bufferfilled > 10000)
-      {
-         m_pSoundBuffer->Play(0, 0, DSBPLAY_LOOPING);
-         m_bufferplaying = true;
-      }
+      if(m_notify[i] != NULL)
+         CloseHandle(m_notify[i]);
+      m_notify[i] = NULL;
    }
-}
 
+   if(m_quitevent != NULL)
+      CloseHandle(m_quitevent);
+   m_quitevent = NULL;
+}
 
 
 //
-// Name :         CDirSoundStream::SetPan()
-// Description :  Set the pan position for a sound.  
-// Parameters :   p_pan - -1 is a full left pan, 1 is a full right pan.  0 is centered.
-//                This function implements logarithmic panning.
+// Name :         CDirSoundStream::WaitDevice()
+// Description :  Wait for the play cursor to reach the start of a
+//                period.  The period before it has just finished
+//                playing, so that is the one to fill.
 //
 
-void CDirSoundStream::SetPan(double p_pan)
+bool CDirSoundStream::WaitDevice()
 {
-   m_pSoundBuffer->SetPan(int(p_pan * 10000));
-}
+   HANDLE events[DSNUMNOTIFY + 1];
+   for(int i=0;  i<DSNUMNOTIFY;  i++)
+      events[i] = m_notify[i];
+   events[DSNUMNOTIFY] = m_quitevent;
 
+   DWORD which = WaitForMultipleObjects(DSNUMNOTIFY + 1, events, FALSE, INFINITE) - WAIT_OBJECT_0;
+   if(which >= DSNUMNOTIFY)
+      return false;
 
-//
-// Name :         CDirSoundStream::SetVolume()
-// Description :  Set the current sound volume.  
-// Parameters :   p_gain - 0 to 1.0, where 1.0 is full volume.  
-//                This function implements logarithmic volume controls.
-//
-
-void CDirSoundStream::SetVolume(double p_gain)
-{
-   m_pSoundBuffer->SetVolume(int(p_gain * (DSBVOLUME_MAX - DSBVOLUME_MIN) + DSBVOLUME_MIN));
+   m_fillperiod = (which + DSNUMNOTIFY - 1) % DSNUMNOTIFY;
+   return true;
 }
 
 
-
+void CDirSoundStream::WakeDevice()
+{
+   SetEvent(m_quitevent);
+}
 
 
 //
-// Name :         CDirSoundStreamThreadProc()
-// Description :  This is the controlling procedure for the thread.  It's called 
-//                by thread creation.
+// Name :        CDirSoundStream::PlayDevice()
+// Description : Copy a period of audio into the direct sound buffer.
 //
 
-UINT CDirSoundStreamThreadProc( LPVOID pParam )
+void CDirSoundStream::PlayDevice(const short *frames, int count)
 {
-	CoInitialize(NULL);
+   short *pBuffer1;
+   DWORD size1;
+   short *pBuffer2;
+   DWORD size2;
+
+   HRESULT hr = m_pSoundBuffer->Lock(m_fillperiod * m_periodbytes, m_periodbytes, 
+      (LPVOID *)(&pBuffer1), &size1, (LPVOID *)(&pBuffer2), &size2, 0);
+
+   // The buffer memory can be lost if another application takes over
+   if(hr == DSERR_BUFFERLOST)
+   {
+      m_pSoundBuffer->Restore();
+      hr = m_pSoundBuffer->Lock(m_fillperiod * m_periodbytes, m_periodbytes, 
+         (LPVOID *)(&pBuffer1), &size1, (LPVOID *)(&pBuffer2), &size2, 0);
+   }
 
-    CDirSoundStream* pObject = (CDirSoundStream *)pParam;
+   if(hr != DS_OK)
+      return;
 
-    if (pObject == NULL ||
-        !pObject->IsKindOf(RUNTIME_CLASS(CDirSoundStream)))
-    return 1;   // if pObject is not valid
+   memcpy(pBuffer1, (const char *)frames, size1);
+   memcpy(pBuffer2, (const char *)frames + size1, size2);
 
-    // And call the code in the driver
-    return pObject->ThreadLoop();
+   m_pSoundBuffer->Unlock(pBuffer1, size1, pBuffer2, size2);
 }
 
 
 //
-// Name :         CDirSoundStream::ThreadLoop()
-// Description :  This is the actual in-class thread loop.
+// Name :         CDirSoundStream::ThreadStarted()
+// Description :  The stream thread uses COM and has to keep up with
+//                the sound card.
 //
 
-UINT CDirSoundStream::ThreadLoop()
+void CDirSoundStream::ThreadStarted()
 {
-    m_threadactive = TRUE;
-
-    // Wait for event indicating the thread can start
-    CSingleLock slock(&m_delaysync);
-    slock.Lock();
-
-    while(true)
-	{
-        Sleep(10);
-        if(!m_threadactive)
-            break;
-
-        DWORD playpos;
-        m_pSoundBuffer->GetCurrentPosition(&playpos, NULL);
-
-        CSingleLock lock(&m_mutex);
-        lock.Lock();
+   CoInitialize(NULL);
+   SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+}
 
-        // How much as played since we last checked?
-        DWORD played = ((playpos + m_buffersize) - m_bufferrdloc) % m_buffersize;
+void CDirSoundStream::ThreadStopped()
+{
+   CoUninitialize();
+}
 
-        m_bufferrdloc = playpos;
-        m_bufferfilled -= played;
 
-        // Handle situation where we are running out of data
-        // Less than 333ms available...
-        if(m_bufferfilled < (m_samplerate / 3) && m_bufferplaying)
-        {
-            m_bufferplaying = false;
-            m_pSoundBuffer->Stop();
-        }
-	}
 
-	// Signal to the foreground process that the thread is done.
-	m_threaddone.SetEvent();
+//
+// Name :         CDirSoundStream::SetPan()
+// Description :  Set the pan position for a sound.  
+// Parameters :   p_pan - -1 is a full left pan, 1 is a full right pan.  0 is centered.
+//                This function implements logarithmic panning.
+//
 
-    return 0;
+void CDirSoundStream::SetPan(double p_pan)
+{
+   m_pSoundBuffer->SetPan(int(p_pan * 10000));
 }
 
 
+//
+// Name :         CDirSoundStream::SetVolume()
+// Description :  Set the current sound volume.  
+// Parameters :   p_gain - 0 to 1.0, where 1.0 is full volume.  
+//                This function implements logarithmic volume controls.
+//
 
+void CDirSoundStream::SetVolume(double p_gain)
+{
+   m_pSoundBuffer->SetVolume(int(p_gain * (DSBVOLUME_MAX - DSBVOLUME_MIN) + DSBVOLUME_MIN));
+}
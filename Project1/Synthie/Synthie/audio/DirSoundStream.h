@@ -9,13 +9,13 @@
 #pragma once
 #endif // _MSC_VER > 1000
 
-#include <afxmt.h>
-
 #include "DirSound.h"
+#include "AudioStream.h"
 
+// The secondary buffer is split into this many periods
 const int DSNUMNOTIFY = 2;
 
-class CDirSoundStream : public CObject
+class CDirSoundStream : public CObject, public CAudioStream
 {
 public:
    CDirSoundStream();
@@ -25,48 +25,34 @@ public:
    void SetDirSound(CDirSound *p_DirSound) {m_pDirSound = p_DirSound;}
 
 	bool Open(CDirSound *p_DirSound=NULL);
-	void WriteFrame(short *p_audio);
-   bool Close();
 
 	void SetVolume(double p_gain);
 	void SetPan(double p_pan);
 
-   void SetChannels(int c) {m_numchannels = c;}
-   void SetSampleRate(int s) {m_samplerate = s;}
-
-   void SetBufferDuration(double d) {m_bufferduration = d;}
-
-   UINT ThreadLoop();
-
 protected:
 	DECLARE_DYNCREATE(CDirSoundStream)
 
+   virtual bool OpenDevice(int &periodFrames);
+   virtual void CloseDevice();
+   virtual bool WaitDevice();
+   virtual void WakeDevice();
+   virtual void PlayDevice(const short *frames, int count);
+   virtual int DeviceFrames() const {return DSNUMNOTIFY * PeriodFrames();}
+   virtual void ThreadStarted();
+   virtual void ThreadStopped();
+
 private:
 	void Initialize();
-	bool InitializeDirectSound();
-
-	int            m_samplerate;
-	int            m_numchannels;
-	bool           m_isopen;
-	volatile bool  m_threadactive;
-	double			m_bufferduration;
+	bool InitializeDirectSound(int periodFrames);
 
-   int            m_buffersize;
-   volatile DWORD m_bufferwrloc;
-   volatile DWORD m_bufferrdloc;
-   volatile int   m_bufferfilled;
-   bool           m_bufferplaying;
+   int            m_periodbytes;    // Bytes in one period of the buffer
+   int            m_fillperiod;     // Period PlayDevice() fills next
 
-   CCriticalSection m_mutex;
-   CEvent         m_threaddone;
-   CEvent         m_delaysync;
+   HANDLE         m_notify[DSNUMNOTIFY];  // Play cursor reached a period
+   HANDLE         m_quitevent;    // Close() wants the thread to stop
 
    CDirSound     *m_pDirSound;
    CComPtr<IDirectSoundBuffer> m_pSoundBuffer;
-
-   // Audio data accumulator
-   short          m_audio[2000];
-   int            m_audiocnt;
 };
 
 #endif // !defined(AFX_DIRSoundStream_H__C453D8B1_8641_4E8C_83D3_9BDB9B1CD06B__INCLUDED_)
@@ -0,0 +1,59 @@
+/*
+ *  Name :         NullAudioStream.cpp
+ *  Description :  An audio output stream with no device behind it.
+ */
+
+#include "pch.h"
+
+#include "NullAudioStream.h"
+
+
+CNullAudioStream::CNullAudioStream()
+{
+    m_realtime = true;
+    m_stop = false;
+}
+
+CNullAudioStream::~CNullAudioStream()
+{
+    Close();
+}
+
+
+bool CNullAudioStream::OpenDevice(int &periodFrames)
+{
+    m_stop = false;
+    m_period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(double(periodFrames) / GetSampleRate()));
+    m_next = std::chrono::steady_clock::now();
+    return true;
+}
+
+
+/*
+ *  Name :         CNullAudioStream::WaitDevice()
+ *  Description :  In real time, wait for the clock to reach the next
+ *                 period.  Otherwise wait for a period to be written.
+ */
+
+bool CNullAudioStream::WaitDevice()
+{
+    if(!m_realtime)
+        return WaitForData(PeriodFrames());
+
+    m_next += m_period;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return !m_wake.wait_until(lock, m_next, [this] { return m_stop; });
+}
+
+
+void CNullAudioStream::WakeDevice()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+
+    m_wake.notify_all();
+}
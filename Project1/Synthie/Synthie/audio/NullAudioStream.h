@@ -0,0 +1,46 @@
+/*
+ *  Name :         NullAudioStream.h
+ *  Description :  An audio output stream with no device behind it.
+ */
+
+#pragma once
+
+#include <chrono>
+
+#include "AudioStream.h"
+
+/*! Audio output stream that discards what it plays
+ *
+ * The simulated device takes a period at a time, either in real time,
+ * as a sound card would, or as soon as a period has been written. Its
+ * clock is FramesPlayed(), so latency and underruns can be measured
+ * anywhere, with no sound hardware.
+ */
+class CNullAudioStream : public CAudioStream
+{
+public:
+    CNullAudioStream();
+    virtual ~CNullAudioStream();
+
+    //! Play in real time (the default), or as fast as frames arrive
+    void SetRealtime(bool r) {m_realtime = r;}
+
+    //! Seconds the simulated device has played
+    double Time() const {return double(FramesPlayed()) / GetSampleRate();}
+
+protected:
+    virtual bool OpenDevice(int &periodFrames);
+    virtual void CloseDevice() {}
+    virtual bool WaitDevice();
+    virtual void WakeDevice();
+    virtual void PlayDevice(const short * /*frames*/, int /*count*/) {}
+
+private:
+    bool m_realtime;
+
+    std::chrono::steady_clock::time_point m_next;  // When the next period is due
+    std::chrono::steady_clock::duration m_period;
+    std::mutex     m_mutex;
+    std::condition_variable m_wake;
+    bool           m_stop;
+};
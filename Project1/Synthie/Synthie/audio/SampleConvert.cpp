@@ -0,0 +1,185 @@
+/*
+ *  Name :         SampleConvert.cpp
+ *  Description :  Conversion of Wave file sample data to float.  Each
+ *                 format has its own kernel, with an SSE2 version (24
+ *                 bit uses SSSE3 where the compiler targets it) and a
+ *                 scalar loop for the tail and for other processors.
+ */
+
+#include "pch.h"
+
+#include <cstring>
+
+#include "SampleConvert.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SYNTHIE_SSE2
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <tmmintrin.h>
+#define SYNTHIE_SSSE3
+#endif
+
+// Unsigned 8 bit, centred on 128
+static void ConvertU8(float* dst, const unsigned char* src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef SYNTHIE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128 scale = _mm_set1_ps(1.f / 128);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i b = _mm_loadl_epi64((const __m128i*)(src + i));
+        __m128i w = _mm_sub_epi16(_mm_unpacklo_epi8(b, zero), bias);
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(w, w), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+
+    for (; i < count; i++)
+        dst[i] = (src[i] - 128) * (1.f / 128);
+}
+
+// Signed 16 bit
+static void ConvertS16(float* dst, const unsigned char* src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef SYNTHIE_SSE2
+    const __m128 scale = _mm_set1_ps(1.f / 32768);
+
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i w = _mm_loadu_si128((const __m128i*)(src + i * 2));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(w, w), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const unsigned char* p = src + i * 2;
+        dst[i] = short(p[0] | (p[1] << 8)) * (1.f / 32768);
+    }
+}
+
+// Signed 24 bit, three bytes per sample
+static void ConvertS24(float* dst, const unsigned char* src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef SYNTHIE_SSSE3
+    // Move each sample into the top three bytes of a 32 bit lane,
+    // then shift down to sign extend it.  Four samples use 12 of the
+    // 16 bytes we load, so this runs while 16 bytes are left to read.
+    const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m128 scale = _mm_set1_ps(1.f / 8388608);
+
+    for (; i + 6 <= count; i += 4)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i * 3));
+        __m128i v = _mm_srai_epi32(_mm_shuffle_epi8(b, shuffle), 8);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+#elif defined(SYNTHIE_SSE2)
+    // Without a byte shuffle, shift the whole register left so each
+    // sample in turn lands in the top three bytes of its lane, and
+    // keep that lane.  Sample j moves up by j + 1 bytes.
+    const __m128i lane0 = _mm_setr_epi32(-1, 0, 0, 0);
+    const __m128i lane1 = _mm_setr_epi32(0, -1, 0, 0);
+    const __m128i lane2 = _mm_setr_epi32(0, 0, -1, 0);
+    const __m128i lane3 = _mm_setr_epi32(0, 0, 0, -1);
+    const __m128 scale = _mm_set1_ps(1.f / 8388608);
+
+    for (; i + 6 <= count; i += 4)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i * 3));
+        __m128i v = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(_mm_slli_si128(b, 1), lane0), _mm_and_si128(_mm_slli_si128(b, 2), lane1)),
+            _mm_or_si128(_mm_and_si128(_mm_slli_si128(b, 3), lane2), _mm_and_si128(_mm_slli_si128(b, 4), lane3)));
+        v = _mm_srai_epi32(v, 8);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const unsigned char* p = src + i * 3;
+        int value = int((unsigned(p[0]) << 8) | (unsigned(p[1]) << 16) | (unsigned(p[2]) << 24)) >> 8;
+        dst[i] = value * (1.f / 8388608);
+    }
+}
+
+// Signed 32 bit
+static void ConvertS32(float* dst, const unsigned char* src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef SYNTHIE_SSE2
+    const __m128 scale = _mm_set1_ps(1.f / 2147483648.f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i * 4));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        const unsigned char* p = src + i * 4;
+        int value = int(p[0] | (p[1] << 8) | (p[2] << 16) | (unsigned(p[3]) << 24));
+        dst[i] = value * (1.f / 2147483648.f);
+    }
+}
+
+// 32 bit float is already what we want
+static void ConvertF32(float* dst, const unsigned char* src, size_t count)
+{
+    memcpy(dst, src, count * sizeof(float));
+}
+
+bool ConvertSamples(float* dst, const unsigned char* src, size_t count, int bytes, bool isFloat)
+{
+    if (isFloat)
+    {
+        if (bytes != 4)
+            return false;
+
+        ConvertF32(dst, src, count);
+        return true;
+    }
+
+    switch (bytes)
+    {
+    case 1:
+        ConvertU8(dst, src, count);
+        break;
+
+    case 2:
+        ConvertS16(dst, src, count);
+        break;
+
+    case 3:
+        ConvertS24(dst, src, count);
+        break;
+
+    case 4:
+        ConvertS32(dst, src, count);
+        break;
+
+    default:
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,18 @@
+/*
+ *  Name :         SampleConvert.h
+ *  Description :  Conversion of Wave file sample data to float.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+/*! Convert count little endian samples to float, scaled to -1 to 1
+ *
+ * bytes is the size of one sample: 1 for unsigned 8 bit, 2, 3 or 4 for
+ * signed integer samples, or 4 with isFloat for 32 bit float.  The
+ * samples are converted in order, so interleaved frames stay
+ * interleaved.  Returns false for a format we don't know, leaving
+ * dst untouched.
+ */
+bool ConvertSamples(float* dst, const unsigned char* src, size_t count, int bytes, bool isFloat);
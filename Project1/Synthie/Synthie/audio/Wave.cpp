@@ -13,7 +13,17 @@
 #include <cmath>
 #include <sstream>
 
-#include "wave.h"
+#include "Wave.h"
+#include "SampleConvert.h"
+
+#ifdef SYNTHIE_HEADLESS
+#include <Utf8.h>
+
+// Without MSVC the file streams only open narrow (UTF-8) paths
+#define WAVE_PATH(f) WideToUtf8(f).c_str()
+#else
+#define WAVE_PATH(f) (f)
+#endif
 
 using namespace std;
 
@@ -41,11 +51,14 @@ inline void IDPlace(char *p_to, const char *p_fm)
 
 CWaveIn::CWaveIn() : CWave(), std::ifstream()
 {
+   _default();
 }
 
 
-CWaveIn::CWaveIn(const LPCTSTR fname) : CWave(), ifstream(fname, ios::binary)
+CWaveIn::CWaveIn(const LPCTSTR fname) : CWave(), ifstream(WAVE_PATH(fname), ios::binary)
 {
+   _default();
+
    if(bad() || !good())
    {
       _Error(TEXT("Unable to open file "), fname, TEXT(" for reading."));
@@ -54,7 +67,7 @@ CWaveIn::CWaveIn(const LPCTSTR fname) : CWave(), ifstream(fname, ios::binary)
 
    // The stream has been opened okay, open the Wave file
    if(!_open())
-      setf(ios::badbit | ios::failbit);
+      setstate(ios::badbit | ios::failbit);
 }
 
 
@@ -63,6 +76,24 @@ CWaveIn::~CWaveIn()
 }
 
 
+/*
+ *  Name :         CWaveIn::_default()
+ *  Description :  An empty wave until a file is opened.
+ */
+
+void
+CWaveIn::_default()
+{
+   soundStart = 0;
+   curFrame = 0;
+   numChannels = 1;
+   numSampleFrames = 0;
+   sampleSize = 16;
+   sampleRate = 44100.;
+   format = 1;
+}
+
+
 /*
  *  Name :         CWaveIn::open()
  *  Description :  Open a file for reading.
@@ -71,7 +102,7 @@ CWaveIn::~CWaveIn()
 bool
 CWaveIn::open(const LPCTSTR fname)
 {
-   ifstream::open(fname, ios::binary);
+   ifstream::open(WAVE_PATH(fname), ios::binary);
 
    if(bad() || !good())
    {
@@ -81,7 +112,7 @@ CWaveIn::open(const LPCTSTR fname)
 
    // The stream has been opened okay, open the Wave file
    if(!_open())
-      setf(ios::badbit | ios::failbit);
+      setstate(ios::badbit | ios::failbit);
 
    return true;
 }
@@ -123,8 +154,9 @@ int CWaveIn::_open()
 	ChunkHeader Header;
 	while (ReadChunkHeader(Header))
 	{
-		// Offset to point after the current chunk
-		int seek_offset = (int)tellg() + Header.ckSize;
+		// Offset to point after the current chunk, which
+		// is padded to an even length
+		int seek_offset = (int)tellg() + Header.ckSize + (Header.ckSize & 1);
 
 		if (strncmp(Header.ckID, "fmt ", 4) == 0) 
 		{
@@ -134,11 +166,6 @@ int CWaveIn::_open()
 
 			int type;
 			ReadSHORT(type);   
-			if(type != 1)
-			{
-				Error(TEXT("Only PCM WAVE files are supported"));
-				return 0;
-			}
 
 			ReadSHORT(numChannels);
 			unsigned long lSampleRate;
@@ -152,6 +179,24 @@ int CWaveIn::_open()
 			ReadSHORT(dummy2);	// Bytes per frame (as if we care)
 
 			ReadSHORT(sampleSize);	// This we might need
+
+			// WAVE_FORMAT_EXTENSIBLE keeps the real format at the
+			// start of its sub-format GUID.
+			if(type == 0xFFFE && Header.ckSize >= 40)
+			{
+				ReadSHORT(dummy2);	// Size of the extension
+				ReadSHORT(dummy2);	// Valid bits per sample
+				ReadULONG(dummy);	// Speaker positions
+				ReadSHORT(type);
+			}
+
+			if(type != 1 && type != 3)
+			{
+				Error(TEXT("Only PCM and float WAVE files are supported"));
+				return 0;
+			}
+
+			format = type;
 		} 
 		else if (strncmp(Header.ckID, "data", 4) == 0) 
 		{
@@ -227,6 +272,50 @@ CWaveIn::ReadFrame(short *frame)
 }
 
 
+/*
+ *  Name :         CWaveIn::ReadFrames()
+ *  Description :  Read up to frames frames of audio as float, scaled
+ *                 to -1 to 1, with the channels interleaved.  Works for
+ *                 8, 16, 24 and 32 bit PCM and 32 bit float.
+ *  Returns :      The number of frames read.
+ */
+
+int
+CWaveIn::ReadFrames(float *dst, int frames)
+{
+   const int chunkFrames = 4096;
+
+   int bytes = (sampleSize + 7) / 8;
+   size_t frameBytes = size_t(numChannels) * bytes;
+
+   if(frames > int(numSampleFrames) - curFrame)
+      frames = int(numSampleFrames) - curFrame;
+
+   readBuffer.resize(chunkFrames * frameBytes);
+
+   int done = 0;
+   while(done < frames)
+   {
+      int n = frames - done;
+      if(n > chunkFrames)
+         n = chunkFrames;
+
+      // Read a run of frames in one go, then convert them all
+      read((char *)&readBuffer[0], n * frameBytes);
+      n = int(gcount() / frameBytes);
+
+      if(n == 0 || !ConvertSamples(dst + size_t(done) * numChannels, &readBuffer[0], 
+                                   size_t(n) * numChannels, bytes, format == 3))
+         break;
+
+      done += n;
+      curFrame += n;
+   }
+
+   return done;
+}
+
+
 /*
  *  Name :         CWaveIn::SeekFrame()
  *  Description :  Set the file position at a particular location in the file.
@@ -237,7 +326,7 @@ CWaveIn::SeekFrame(int frame)
 {
    clear();
    curFrame = frame;
-   seekg(soundStart + frame * numChannels * (sampleSize + 7) / 8);
+   seekg(std::streamoff(soundStart) + std::streamoff(frame) * numChannels * ((sampleSize + 7) / 8));
    return !fail();
 }
 
@@ -382,7 +471,7 @@ CWaveOut::CWaveOut(const LPCTSTR fname) : CWave()
 {
    _default();
 
-   ofstream::open(fname, ios::binary | ios::out);
+   ofstream::open(WAVE_PATH(fname), ios::binary | ios::out);
 
    if(bad() || !good())
    {
@@ -392,7 +481,7 @@ CWaveOut::CWaveOut(const LPCTSTR fname) : CWave()
 
    // The stream has been opened okay, open the Wave file
    if(!_open())
-      setf(ios::badbit | ios::failbit);
+      setstate(ios::badbit | ios::failbit);
 }
 
 
@@ -411,7 +500,7 @@ void
 CWaveOut::open(const LPCTSTR fname)
 {
    ofstream::clear();
-   ofstream::open(fname, ios::binary | ios::out);
+   ofstream::open(WAVE_PATH(fname), ios::binary | ios::out);
 
    if(bad() || !good())
    {
@@ -421,7 +510,7 @@ CWaveOut::open(const LPCTSTR fname)
 
    // The stream has been opened okay, open the Wave file
    if(!_open())
-      setf(ios::badbit | ios::failbit);
+      setstate(ios::badbit | ios::failbit);
 }
 
 
@@ -433,8 +522,18 @@ CWaveOut::open(const LPCTSTR fname)
 void
 CWaveOut::_default()
 {
+   m_fillBuffer = 0;
+   m_nextWrite = 0;
+   m_queued = 0;
+   m_writing = false;
+   m_stopWriter = false;
+   m_writeFailed = false;
+   for(int b=0;  b<NumWriteBuffers;  b++)
+      m_writeSizes[b] = 0;
+
    isopen = 0;
    isstarted = 0;
+   isfloat = 0;
    numChannels = 1;
    sampleSize = 16;
    sampleRate = 44100.;
@@ -480,10 +579,26 @@ CWaveOut::_headers()
    form.ckSize = 0;      // Have to rewrite later
    WriteChunk(form);
 
+   // Leave room for a ds64 chunk in case the file grows past what
+   // the 32 bit RIFF sizes can hold.  Until then it is a JUNK chunk,
+   // which readers skip.
+   m_ds64Loc = (unsigned long)tellp();
+
+   ChunkHeader junk;
+   IDPlace(junk.ckID, "JUNK");
+   junk.ckSize = 28;
+   WriteChunkHeader(junk);
+   for(int i=0;  i<7;  i++)
+      WriteULONG(0);
+
+   // Float samples are always 32 bits
+   if(isfloat)
+      sampleSize = 32;
+
    // Write the fmt  header
    ChunkHeader fmt;
    IDPlace(fmt.ckID, "fmt ");
-   fmt.ckSize = 16;
+   fmt.ckSize = isfloat ? 18 : 16;
    WriteChunkHeader(fmt);
    if(fail() || bad())
    {
@@ -493,12 +608,27 @@ CWaveOut::_headers()
 
    int bytesper = (sampleSize + 7) / 8;
 
-   WriteSHORT(1);		// Only PCM is supported
+   WriteSHORT(isfloat ? 3 : 1);		// PCM or IEEE float
    WriteSHORT(numChannels);
    WriteULONG((unsigned long)(sampleRate));
    WriteULONG((unsigned long)(sampleRate) * numChannels * bytesper);
    WriteSHORT(numChannels * bytesper);
    WriteSHORT(sampleSize);
+   if(isfloat)
+      WriteSHORT(0);		// No extra format bytes
+
+   // Formats other than PCM need a fact chunk with the number of
+   // sample frames, which we fill in at the end like the lengths
+   if(isfloat)
+   {
+      m_factLoc = (unsigned long)tellp();
+
+      ChunkHeader fact;
+      IDPlace(fact.ckID, "fact");
+      fact.ckSize = 4;
+      WriteChunkHeader(fact);
+      WriteULONG(0);		// Have to fill in later
+   }
    
    m_lenLoc = (int)tellp();		// Save off location for data length
 
@@ -535,18 +665,61 @@ void CWaveOut::close()
    if(!isstarted)
       _headers();
 
+   // Let the writer thread finish with what we gave it
+   StopWriter();
+
    isopen = 0;
 
-   // How long is the file?
-   unsigned long flen = (int)tellp();
+   // How long is the sound data?  An odd length gets a pad byte.
+   unsigned long long dataLen = (unsigned long long)tellp() - m_lenLoc - 8;
+   if(dataLen & 1)
+      put(0);
 
-   // Write in the sound length
-   seekp(m_lenLoc + 4);
-   WriteULONG(flen - m_lenLoc - 8);
+   unsigned long long riffLen = (unsigned long long)tellp() - 8;
+
+   if(riffLen <= 0xFFFFFFFFul)
+   {
+      // Write in the sound length
+      seekp(m_lenLoc + 4);
+      WriteULONG((unsigned long)dataLen);
 
-   // Write in the entire file length
-   seekp(4l);
-   WriteULONG(flen - 8);
+      // Write in the entire file length
+      seekp(4l);
+      WriteULONG((unsigned long)riffLen);
+
+      if(isfloat)
+      {
+         seekp(m_factLoc + 8);
+         WriteULONG((unsigned long)numSampleFrames);
+      }
+   }
+   else
+   {
+      // Too big for RIFF.  This becomes an RF64 file, with the
+      // real lengths in the ds64 chunk and the 32 bit lengths
+      // all set to 0xFFFFFFFF.
+      seekp(0l);
+      WriteID("RF64");
+      WriteULONG(0xFFFFFFFFul);
+
+      seekp(m_ds64Loc);
+      WriteID("ds64");
+      WriteULONG(28);
+      WriteULONGLONG(riffLen);
+      WriteULONGLONG(dataLen);
+      WriteULONGLONG(numSampleFrames);
+      WriteULONG(0);		// No table of other chunk sizes
+
+      seekp(m_lenLoc + 4);
+      WriteULONG(0xFFFFFFFFul);
+
+      // The frame count is in the ds64 chunk
+      if(isfloat)
+      {
+         seekp(m_factLoc + 8);
+         WriteULONG(0xFFFFFFFFul);
+      }
+   }
 
    if(fail() || bad())
    {
@@ -574,9 +747,22 @@ CWaveOut::WriteFrame(short *frame)
    if(!isstarted)
       _headers();
 
+   // Frames already handed to the writer thread go first
+   StopWriter();
+
    signed char b[2];
 
-   if(sampleSize == 16)
+   if(isfloat)
+   {
+      for(int c=0;  c<numChannels;  c++)
+      {
+         float f = frame[c] / 32768.f;
+         unsigned long bits;
+         memcpy(&bits, &f, 4);
+         WriteULONG(bits);
+      }
+   }
+   else if(sampleSize == 16)
    {
       for(int c=0;  c<numChannels;  c++)
       {
@@ -601,6 +787,184 @@ CWaveOut::WriteFrame(short *frame)
 
 
 
+/*
+ *  Name :         CWaveOut::WriteFrames()
+ *  Description :  Write count interleaved frames of float audio.
+ *                 Samples are clipped to the range of the sample size.
+ *                 The frames are converted into the buffer we are
+ *                 filling, and full buffers go to the writer thread.
+ *  Returns :      false if writing has failed.
+ */
+
+int
+CWaveOut::WriteFrames(const float *frames, int count)
+{
+   if(!isstarted)
+      _headers();
+
+   if(!m_writing)
+      StartWriter();
+
+   char *buffer = &m_writeBuffers[m_fillBuffer][0];
+   size_t size = m_writeSizes[m_fillBuffer];
+   size_t samples = size_t(count) * numChannels;
+
+   for(size_t i=0;  i<samples;  i++)
+   {
+      if(isfloat)
+      {
+         // Float samples are written as they are, little endian
+         unsigned int bits;
+         memcpy(&bits, &frames[i], 4);
+         for(int k=0;  k<4;  k++, bits >>= 8)
+            buffer[size++] = (char)(bits & 0xff);
+      }
+      else
+      {
+         float d = frames[i] * 32767.f;
+         if(d < -32768)
+            d = -32768;
+         else if(d > 32767)
+            d = 32767;
+
+         short sample = (short)d;
+
+         if(sampleSize == 16)
+         {
+            buffer[size++] = (char)(sample);
+            buffer[size++] = (char)(sample >> 8);
+         }
+         else
+         {
+            // 8 bit samples are unsigned
+            buffer[size++] = (char)((sample >> 8) + 128);
+         }
+      }
+
+      // The buffer size is a whole number of samples
+      if(size == WriteBufferBytes)
+      {
+         m_writeSizes[m_fillBuffer] = size;
+         QueueBuffer();
+
+         buffer = &m_writeBuffers[m_fillBuffer][0];
+         size = 0;
+      }
+   }
+
+   m_writeSizes[m_fillBuffer] = size;
+   numSampleFrames += count;
+   return !m_writeFailed;
+}
+
+
+/*
+ *  Name :         CWaveOut::QueueBuffer()
+ *  Description :  Hand the buffer we are filling to the writer thread
+ *                 and move on to the next one, waiting if the writer
+ *                 still has it.
+ */
+
+void
+CWaveOut::QueueBuffer()
+{
+   std::unique_lock<std::mutex> lock(m_writeMutex);
+
+   m_queued++;
+   m_fillBuffer = (m_fillBuffer + 1) % NumWriteBuffers;
+   m_writeCond.notify_all();
+
+   m_writeCond.wait(lock, [this] { return m_queued < NumWriteBuffers; });
+   m_writeSizes[m_fillBuffer] = 0;
+}
+
+
+/*
+ *  Name :         CWaveOut::StartWriter()
+ *  Description :  Start the writer thread.  The stream belongs to it
+ *                 until StopWriter().
+ */
+
+void
+CWaveOut::StartWriter()
+{
+   for(int b=0;  b<NumWriteBuffers;  b++)
+      m_writeBuffers[b].resize(WriteBufferBytes);
+
+   m_fillBuffer = 0;
+   m_nextWrite = 0;
+   m_queued = 0;
+   m_writeSizes[0] = 0;
+   m_stopWriter = false;
+   m_writeFailed = false;
+   m_writing = true;
+
+   m_writer = std::thread(&CWaveOut::WriterLoop, this);
+}
+
+
+/*
+ *  Name :         CWaveOut::StopWriter()
+ *  Description :  Queue any partly filled buffer, wait for the writer
+ *                 thread to write everything, and stop it.
+ */
+
+void
+CWaveOut::StopWriter()
+{
+   if(!m_writing)
+      return;
+
+   if(m_writeSizes[m_fillBuffer] > 0)
+      QueueBuffer();
+
+   {
+      std::lock_guard<std::mutex> lock(m_writeMutex);
+      m_stopWriter = true;
+   }
+
+   m_writeCond.notify_all();
+   m_writer.join();
+   m_writing = false;
+
+   if(m_writeFailed)
+      setstate(ios::badbit);
+}
+
+
+/*
+ *  Name :         CWaveOut::WriterLoop()
+ *  Description :  The writer thread.  Writes queued buffers in order
+ *                 until it is stopped with nothing left to write.
+ */
+
+void
+CWaveOut::WriterLoop()
+{
+   std::unique_lock<std::mutex> lock(m_writeMutex);
+
+   for(;;)
+   {
+      m_writeCond.wait(lock, [this] { return m_queued > 0 || m_stopWriter; });
+      if(m_queued == 0)
+         break;
+
+      int b = m_nextWrite;
+
+      // Write without holding the lock so the caller can keep filling
+      lock.unlock();
+      write(&m_writeBuffers[b][0], m_writeSizes[b]);
+      if(ofstream::fail())
+         m_writeFailed = true;
+      lock.lock();
+
+      m_nextWrite = (m_nextWrite + 1) % NumWriteBuffers;
+      m_queued--;
+      m_writeCond.notify_all();
+   }
+}
+
+
 /*
  *  Name :         CWaveOut::WriteChunk()
  *  Description :  This writes an object of type Chunk to disk,
@@ -691,6 +1055,20 @@ CWaveOut::WriteULONG(unsigned long item)
 }
 
 
+/*
+ *  Name :         CWaveOut::WriteULONGLONG()
+ *  Description :  Writes a 64 bit RF64 size.
+ */
+
+int
+CWaveOut::WriteULONGLONG(unsigned long long item)
+{
+   WriteULONG((unsigned long)(item & 0xFFFFFFFFul));
+   WriteULONG((unsigned long)(item >> 32));
+   return 1;
+}
+
+
 /*
  *  Name :         CWaveOut::WriteSHORT()
  *  Description :  Writes an Wave file object of type SHORT
@@ -724,7 +1102,11 @@ CWaveOut::WriteSHORT(int item)
  */
 void CWave::Error(LPCTSTR str)
 {
+#ifdef SYNTHIE_HEADLESS
+   wcerr << str << endl;
+#else
    AfxMessageBox(str, MB_OK | MB_ICONEXCLAMATION);
+#endif
 }
 
 
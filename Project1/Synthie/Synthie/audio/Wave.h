@@ -8,6 +8,12 @@
 #define _WAVE_H
 
 #include <fstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 /*! Abstract base class for wave file handling
  *
@@ -62,6 +68,7 @@ public:
 
 	void Rewind();
 	int ReadFrame(short *);
+	int ReadFrames(float *dst, int frames);
 	int SeekFrame(int frame);
 
 	int CurFrame() const {return curFrame;}
@@ -69,8 +76,11 @@ public:
 	int NumSampleFrames() const {return numSampleFrames;}
 	int SampleSize() const {return sampleSize;}
 	double SampleRate() const {return sampleRate;}
+	bool IsFloat() const {return format == 3;}
+	bool fail() {return std::ifstream::fail();}
 
 private:
+	void _default();
 	int _open();
 
 	int ReadChunk(Chunk &chunk);
@@ -86,11 +96,17 @@ private:
 	unsigned long numSampleFrames;	// Total sample frames
 	int sampleSize;		// Sample size in bits
 	double sampleRate;		// Samples per second
+	int format;			// 1 for PCM, 3 for float
+	std::vector<unsigned char> readBuffer;	// Raw data for ReadFrames()
 };
 
 /*! Wave audio output class
  *
  * Allows for writing .wav files
+ *
+ * WriteFrames() hands blocks of frames to a writer thread through a
+ * small ring of buffers, so the caller only waits on the disk when
+ * every buffer is still waiting to be written.
  */
 class CWaveOut : public CWave, private std::ofstream
 {
@@ -101,34 +117,64 @@ public:
 
    void open(const LPCTSTR);
    void close();
-   bool fail() {return std::ofstream::fail();}
+   bool fail() {return m_writing ? m_writeFailed.load() : std::ofstream::fail();}
 
    int WriteFrame(short *);
 
+   //! Write frames interleaved frames of float audio, scaled -1 to 1
+   int WriteFrames(const float *frames, int count);
+
    void NumChannels(int n) {numChannels = n;}
    void SampleSize(int s) {sampleSize = s;}
    void SampleRate(double d) {sampleRate = d;}
 
+   //! Write 32 bit float samples instead of integer ones
+   void FloatSamples(bool f) {isfloat = f;}
+
 private:
    void _default();
    int _open();
    int _headers();
 
+   void StartWriter();
+   void StopWriter();
+   void QueueBuffer();
+   void WriterLoop();
+
    int WriteChunk(const Chunk &chunk);
    int WriteChunkHeader(const ChunkHeader &chunk);
    int WriteID(const ID id);
    int WriteLONG(long item);
    int WriteULONG(unsigned long item);
+   int WriteULONGLONG(unsigned long long item);
    int WriteSHORT(int item);
    
    unsigned long m_lenLoc;	// Location in file to write length
+   unsigned long m_ds64Loc;	// Location of the space for a ds64 chunk
+   unsigned long m_factLoc;	// Location of the fact chunk of float files
    int isopen;
-   unsigned long numSampleFrames;
+   int isfloat;			// Writing float samples?
+   unsigned long long numSampleFrames;
    int numChannels;		// Number of audio channels
    int sampleSize;		// Sample size in bits
    double sampleRate;		// Samples per second
 
    int isstarted;	       	// For delayed writing of fmt chunk
+
+   // Asynchronous writing for WriteFrames()
+   static const int NumWriteBuffers = 3;
+   static const size_t WriteBufferBytes = 64 * 1024;
+   std::vector<char> m_writeBuffers[NumWriteBuffers];
+   size_t m_writeSizes[NumWriteBuffers];	// Bytes in each buffer
+   int m_fillBuffer;		// Buffer WriteFrames() is filling
+   int m_nextWrite;		// Next buffer the writer thread writes
+   int m_queued;		// Buffers waiting for or being written
+   bool m_writing;		// Is the writer thread running?
+   bool m_stopWriter;
+   std::atomic<bool> m_writeFailed;
+   std::thread m_writer;
+   std::mutex m_writeMutex;
+   std::condition_variable m_writeCond;
 };
 
 #endif
@@ -0,0 +1,267 @@
+/*
+ *  Name :         WaveMap.cpp
+ *  Description :  Read-only, memory mapped access to Wave files.
+ */
+
+#include "pch.h"
+
+#include <cstring>
+
+#include "WaveMap.h"
+
+#ifdef SYNTHIE_HEADLESS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <Utf8.h>
+#endif
+
+// Little endian fields of the file
+static unsigned ReadU16(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static unsigned long ReadU32(const unsigned char* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+
+/*
+ *  Name :         CWaveMap::CWaveMap()
+ *  Description :  Constructors.  We can construct with a filename or
+ *                 without.
+ */
+
+CWaveMap::CWaveMap()
+{
+    _default();
+}
+
+CWaveMap::CWaveMap(const LPCTSTR fname)
+{
+    _default();
+    open(fname);
+}
+
+CWaveMap::~CWaveMap()
+{
+    close();
+}
+
+void CWaveMap::_default()
+{
+    m_file = NULL;
+    m_fileSize = 0;
+    m_data = NULL;
+    m_dataSize = 0;
+
+#ifdef SYNTHIE_HEADLESS
+    m_fd = -1;
+#else
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = NULL;
+#endif
+
+    numChannels = 0;
+    numSampleFrames = 0;
+    sampleSize = 0;
+    sampleRate = 0;
+    format = Unknown;
+}
+
+
+/*
+ *  Name :         CWaveMap::open()
+ *  Description :  Map a file into memory and check its headers.
+ */
+
+bool CWaveMap::open(const LPCTSTR fname)
+{
+    close();
+
+    size_t fileSize = 0;
+
+#ifdef SYNTHIE_HEADLESS
+    m_fd = ::open(WideToUtf8(fname).c_str(), O_RDONLY);
+    if (m_fd < 0)
+    {
+        _Error(TEXT("Unable to open file "), fname, TEXT(" for reading."));
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(m_fd, &st) == 0)
+        fileSize = size_t(st.st_size);
+
+    if (fileSize > 0)
+    {
+        void* view = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, m_fd, 0);
+        if (view != MAP_FAILED)
+            m_file = (const unsigned char*)view;
+    }
+#else
+    m_hFile = CreateFile(fname, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        _Error(TEXT("Unable to open file "), fname, TEXT(" for reading."));
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(m_hFile, &size))
+        fileSize = size_t(size.QuadPart);
+
+    if (fileSize > 0)
+    {
+        m_hMapping = CreateFileMapping(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_hMapping != NULL)
+            m_file = (const unsigned char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#endif
+
+    if (m_file == NULL)
+    {
+        Error(TEXT("File is not a valid Wave file"));
+        close();
+        return false;
+    }
+
+    m_fileSize = fileSize;
+
+    if (!_open(fileSize))
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+/*
+ *  Name :         CWaveMap::close()
+ *  Description :  Release the mapping and the file.
+ */
+
+void CWaveMap::close()
+{
+#ifdef SYNTHIE_HEADLESS
+    if (m_file != NULL)
+        munmap((void*)m_file, m_fileSize);
+    if (m_fd >= 0)
+        ::close(m_fd);
+#else
+    if (m_file != NULL)
+        UnmapViewOfFile(m_file);
+    if (m_hMapping != NULL)
+        CloseHandle(m_hMapping);
+    if (m_hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(m_hFile);
+#endif
+
+    _default();
+}
+
+
+/*
+ *  Name :         CWaveMap::_open()
+ *  Description :  Walk the chunks of the mapped file, checking that
+ *                 every one of them fits in the file, and find the
+ *                 format and the sound data.
+ */
+
+bool CWaveMap::_open(size_t fileSize)
+{
+    const unsigned char* p = m_file;
+
+    if (fileSize < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p + 8, "WAVE", 4) != 0)
+    {
+        Error(TEXT("File is not a valid Wave file"));
+        return false;
+    }
+
+    // Some writers leave the RIFF size wrong, so we trust the file size
+    bool haveFormat = false;
+    size_t pos = 12;
+
+    while (pos + 8 <= fileSize)
+    {
+        const unsigned char* header = p + pos;
+        size_t size = ReadU32(header + 4);
+        size_t body = pos + 8;
+        size_t avail = fileSize - body;
+
+        if (memcmp(header, "fmt ", 4) == 0)
+        {
+            if (size < 16 || size > avail)
+            {
+                Error(TEXT("Error reading Wave file."));
+                return false;
+            }
+
+            const unsigned char* fmt = p + body;
+            format = ReadU16(fmt);
+            numChannels = ReadU16(fmt + 2);
+            sampleRate = ReadU32(fmt + 4);
+            sampleSize = ReadU16(fmt + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE keeps the real format at the
+            // start of its sub-format GUID.
+            if (format == Extensible && size >= 40)
+                format = ReadU16(fmt + 24);
+
+            if (format != PCM && format != Float)
+            {
+                Error(TEXT("Only PCM and float WAVE files are supported"));
+                return false;
+            }
+
+            haveFormat = true;
+        }
+        else if (memcmp(header, "data", 4) == 0)
+        {
+            if (!haveFormat || numChannels < 1 || sampleSize < 1)
+            {
+                Error(TEXT("Error reading Wave file."));
+                return false;
+            }
+
+            // A truncated file plays what it has
+            if (size > avail)
+                size = avail;
+
+            size_t frameBytes = size_t(numChannels) * BytesPerSample();
+            numSampleFrames = int(size / frameBytes);
+            m_data = p + body;
+            m_dataSize = numSampleFrames * frameBytes;
+            return true;
+        }
+
+        // Chunks are padded to an even length
+        if (size > avail)
+            break;
+
+        pos = body + size + (size & 1);
+    }
+
+    Error(TEXT("Unable to find sound data in Wave file."));
+    return false;
+}
+
+
+/*
+ *  Name :         CWaveMap::IsSampleType()
+ *  Description :  Is a type of this size the type of our samples?
+ */
+
+bool CWaveMap::IsSampleType(size_t size, bool isFloat) const
+{
+    if (m_data == NULL || size * 8 != size_t(sampleSize))
+        return false;
+
+    return isFloat == (format == Float);
+}
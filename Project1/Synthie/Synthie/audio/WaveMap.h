@@ -0,0 +1,115 @@
+/*
+ *  Name :         WaveMap.h
+ *  Description :  Read-only, memory mapped access to Wave files.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include "Wave.h"
+
+/*! A typed, read-only view of samples in memory
+ *
+ * This does not own the memory it points to.
+ */
+template<class T> class CWaveSpan
+{
+public:
+    CWaveSpan() : m_data(NULL), m_size(0) {}
+    CWaveSpan(const T* data, size_t size) : m_data(data), m_size(size) {}
+
+    const T* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const T& operator[](size_t i) const { return m_data[i]; }
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+
+private:
+    const T* m_data;
+    size_t m_size;
+};
+
+/*! Memory mapped WAVE file input
+ *
+ * Maps the whole file into memory, checks its RIFF, fmt and data
+ * chunks, and exposes the sample data where it lies in the mapping,
+ * without copying it. The operating system shares the pages with
+ * anything else that has the file open or cached.
+ *
+ * Samples are interleaved and little endian, as in the file.
+ */
+class CWaveMap : public CWave
+{
+public:
+    //! Format tags this class knows about
+    enum Format { Unknown = 0, PCM = 1, Float = 3, Extensible = 0xFFFE };
+
+    CWaveMap();
+    CWaveMap(const LPCTSTR);
+    virtual ~CWaveMap();
+
+    //! Map a file, returning false if it can't be used
+    bool open(const LPCTSTR);
+    void close();
+    bool fail() const { return m_data == NULL; }
+
+    int NumChannels() const { return numChannels; }
+    int NumSampleFrames() const { return numSampleFrames; }
+    int SampleSize() const { return sampleSize; }
+    double SampleRate() const { return sampleRate; }
+
+    //! PCM or Float; extensible files report their sub-format
+    int SampleFormat() const { return format; }
+
+    //! Bytes in one sample of one channel
+    int BytesPerSample() const { return (sampleSize + 7) / 8; }
+
+    //! The raw sample data, NumSampleFrames() * NumChannels() samples
+    const unsigned char* Data() const { return m_data; }
+
+    //! Size of Data() in bytes
+    size_t DataSize() const { return m_dataSize; }
+
+    //! The sample data as T, or an empty span if T is not the sample type
+    /*! Use unsigned char for 8 bit, short for 16 bit, int for 32 bit
+     *  PCM, and float for 32 bit float. 24 bit samples are only
+     *  available from Data(). */
+    template<class T> CWaveSpan<T> Samples() const;
+
+private:
+    void _default();
+    bool _open(size_t fileSize);
+    bool IsSampleType(size_t size, bool isFloat) const;
+
+    const unsigned char* m_file;    // Start of the mapping
+    size_t m_fileSize;
+    const unsigned char* m_data;    // Start of the sample data
+    size_t m_dataSize;
+
+#ifdef SYNTHIE_HEADLESS
+    int m_fd;
+#else
+    HANDLE m_hFile;
+    HANDLE m_hMapping;
+#endif
+
+    int numChannels;        // Number of audio channels
+    int numSampleFrames;    // Total sample frames
+    int sampleSize;         // Sample size in bits
+    double sampleRate;      // Samples per second
+    int format;             // PCM or Float
+};
+
+template<class T> CWaveSpan<T> CWaveMap::Samples() const
+{
+    if (!IsSampleType(sizeof(T), std::is_floating_point<T>::value))
+        return CWaveSpan<T>();
+
+    // The data chunk need not be aligned for T
+    if (reinterpret_cast<size_t>(m_data) % alignof(T) != 0)
+        return CWaveSpan<T>();
+
+    return CWaveSpan<T>(reinterpret_cast<const T*>(m_data), size_t(numSampleFrames) * numChannels);
+}
@@ -9,14 +9,20 @@
 
 #include "pch.h"
 #include "WaveformBuffer.h"
+#include <climits>
 
 CWaveformBuffer::CWaveformBuffer(void)
 {
     m_sampleRate = 44100.;
     m_channels = 0;
+    m_redrawRate = 1;
+    m_redraw = 1;
     m_capacity = 10.;
+    m_ring = false;
     m_capacitySamples = 0;
-    m_cnt = 0;
+    m_limit = 0;
+    m_total = 0;
+    m_pos = 0;
 }
 
 CWaveformBuffer::~CWaveformBuffer(void)
@@ -40,27 +46,247 @@ void CWaveformBuffer::UpdateAllViews()
 }
 
 //
-// Name :         CWaveformBuffer::Clear(
+// Name :         CWaveformBuffer::Start()
 // Description :  Clear the buffer and prepare to accumulate audio data.
+//                All of the storage is allocated here, so adding
+//                frames never allocates.
 //
 
 void CWaveformBuffer::Start(int p_channels, double p_sampleRate)
 {
     m_channels = p_channels;
     m_sampleRate = p_sampleRate;
-    m_buffer.clear();
-    m_buffer.resize(m_channels);
-
-    m_redrawRate = int(m_sampleRate);
 
     // What is the capacity in actual samples?
     m_capacitySamples = int(m_sampleRate * m_capacity);
+    if(m_capacitySamples < 1)
+        m_capacitySamples = 1;
+
+    m_samples.assign(size_t(m_channels) * m_capacitySamples, 0);
+
+    // Each level has room for the buckets that can overlap the
+    // buffer, up to a level whose buckets are as big as the buffer.
+    std::vector<std::vector<Peak> > levels;
+    for(long long size=PeakBucket;  ;  size <<= 1)
+    {
+        levels.push_back(std::vector<Peak>(size_t(m_capacitySamples / size + 2)));
+        if(size >= m_capacitySamples)
+            break;
+    }
+
+    m_peaks.assign(m_channels, levels);
+    m_bucket.resize(m_channels);
+    ClearBuckets();
+
+    m_redrawRate = int(m_sampleRate);
+    if(m_redrawRate < 1)
+        m_redrawRate = 1;
+    m_redraw = m_redrawRate;
+
+    m_limit = m_ring ? LLONG_MAX : m_capacitySamples;
 
     // Sample counter
-    m_cnt = 0;
+    m_total = 0;
+    m_pos = 0;
 }
 
 void CWaveformBuffer::End()
 {
     UpdateAllViews();
 }
+
+//
+// Name :         CWaveformBuffer::Frames()
+// Description :  Add a block of interleaved frames.  The block is
+//                copied in runs that end at a bucket boundary or where
+//                the ring wraps, a channel at a time.
+//
+
+void CWaveformBuffer::Frames(const short *p_frames, int p_count)
+{
+    bool redraw = false;
+
+    while(p_count > 0 && m_total < m_limit)
+    {
+        int run = PeakBucket - int(m_total & (PeakBucket - 1));
+        if(run > m_capacitySamples - m_pos)
+            run = m_capacitySamples - m_pos;
+        if(run > p_count)
+            run = p_count;
+        if(run > m_limit - m_total)
+            run = int(m_limit - m_total);
+
+        for(int c=0;  c<m_channels;  c++)
+        {
+            short *dest = &m_samples[size_t(c) * m_capacitySamples + m_pos];
+            const short *src = p_frames + c;
+            Peak &peak = m_bucket[c];
+
+            for(int i=0;  i<run;  i++)
+            {
+                short s = src[i * m_channels];
+                dest[i] = s;
+                if(s < peak.lo)
+                    peak.lo = s;
+                if(s > peak.hi)
+                    peak.hi = s;
+            }
+        }
+
+        m_total += run;
+        m_pos += run;
+        if(m_pos == m_capacitySamples)
+            m_pos = 0;
+
+        p_frames += run * m_channels;
+        p_count -= run;
+
+        if((m_total & (PeakBucket - 1)) == 0)
+            AddPeaks();
+
+        m_redraw -= run;
+        if(m_redraw <= 0 || m_total == m_capacitySamples)
+        {
+            m_redraw += m_redrawRate;
+            redraw = true;
+        }
+    }
+
+    if(redraw)
+        UpdateAllViews();
+}
+
+
+void CWaveformBuffer::ClearBuckets()
+{
+    for(int c=0;  c<m_channels;  c++)
+    {
+        m_bucket[c].lo = 32767;
+        m_bucket[c].hi = -32768;
+    }
+}
+
+//
+// Name :         CWaveformBuffer::AddPeaks()
+// Description :  A level 0 bucket has filled.  Add its peaks to the
+//                pyramid, and every time it completes a pair of
+//                buckets, combine the pair into the level above.
+//
+
+void CWaveformBuffer::AddPeaks()
+{
+    // The bucket that just filled
+    long long bucket = (m_total >> PeakShift) - 1;
+
+    for(int c=0;  c<m_channels;  c++)
+    {
+        std::vector<std::vector<Peak> > &levels = m_peaks[c];
+        Peak peak = m_bucket[c];
+        long long b = bucket;
+
+        for(size_t level=0;  level<levels.size();  level++)
+        {
+            std::vector<Peak> &peaks = levels[level];
+
+            peaks[size_t(b % peaks.size())] = peak;
+            if((b & 1) == 0)
+                break;
+
+            const Peak &other = peaks[size_t((b - 1) % peaks.size())];
+            if(other.lo < peak.lo)
+                peak.lo = other.lo;
+            if(other.hi > peak.hi)
+                peak.hi = other.hi;
+
+            b >>= 1;
+        }
+    }
+
+    ClearBuckets();
+}
+
+//
+// Name :         CWaveformBuffer::GetPeaks()
+// Description :  Find the lowest and highest samples from p_begin up
+//                to p_end.  The range is split into the largest whole
+//                buckets the pyramid has, working in from both ends,
+//                so only the ends look at the samples themselves.
+//                Buckets are numbered from the first frame added, so
+//                the range is moved there before climbing.
+//
+
+CWaveformBuffer::Peak CWaveformBuffer::GetPeaks(int p_channel, int p_begin, int p_end) const
+{
+    Peak peak;
+    peak.lo = 32767;
+    peak.hi = -32768;
+
+    int size = GetSize();
+    if(p_begin < 0)
+        p_begin = 0;
+    if(p_end > size)
+        p_end = size;
+    if(p_begin >= p_end)
+    {
+        peak.lo = peak.hi = 0;
+        return peak;
+    }
+
+    const std::vector<std::vector<Peak> > &levels = m_peaks[p_channel];
+
+    long long oldest = m_total - size;
+    long long begin = oldest + p_begin;
+    long long end = oldest + p_end;
+
+    // Samples up to the first whole bucket, and after the last
+    long long first = (begin + PeakBucket - 1) & ~(long long)(PeakBucket - 1);
+    long long last = end & ~(long long)(PeakBucket - 1);
+    if(first >= last)
+        first = last = end;
+
+    for(long long i=begin;  i<first;  i++)
+    {
+        short s = GetSample(p_channel, int(i - oldest));
+        if(s < peak.lo) peak.lo = s;
+        if(s > peak.hi) peak.hi = s;
+    }
+
+    for(long long i=last;  i<end;  i++)
+    {
+        short s = GetSample(p_channel, int(i - oldest));
+        if(s < peak.lo) peak.lo = s;
+        if(s > peak.hi) peak.hi = s;
+    }
+
+    // The whole buckets in between, climbing the pyramid
+    long long l = first >> PeakShift;
+    long long r = last >> PeakShift;
+    for(size_t level=0;  l < r && level < levels.size();  level++)
+    {
+        const std::vector<Peak> &peaks = levels[level];
+
+        // The top level takes whatever is left
+        bool top = level + 1 == levels.size();
+
+        while(l < r && ((l & 1) || top))
+        {
+            const Peak &p = peaks[size_t(l % peaks.size())];
+            if(p.lo < peak.lo) peak.lo = p.lo;
+            if(p.hi > peak.hi) peak.hi = p.hi;
+            l++;
+        }
+
+        if(l < r && (r & 1))
+        {
+            r--;
+            const Peak &p = peaks[size_t(r % peaks.size())];
+            if(p.lo < peak.lo) peak.lo = p.lo;
+            if(p.hi > peak.hi) peak.hi = p.hi;
+        }
+
+        l >>= 1;
+        r >>= 1;
+    }
+
+    return peak;
+}
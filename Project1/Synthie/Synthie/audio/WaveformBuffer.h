@@ -17,15 +17,38 @@
 // This is a class that buffers a segment of a waveform that can
 // then be displayed using CWaveformWnd.
 //
+// The samples are kept in one block of memory allocated by Start(),
+// each channel's samples one after another.  Normally the buffer
+// holds the first SetCapacity() seconds and ignores anything after
+// that.  In ring mode it keeps the most recent SetCapacity() seconds
+// instead, so a render of any length can be watched.  Sample and
+// peak positions are always counted from the oldest frame held.
+//
+// Alongside the samples it keeps a pyramid of min/max peaks.  Level 0
+// holds the peaks of each PeakBucket frames, and each level above
+// holds the peaks of two buckets of the level below.  Each level is
+// a ring indexed by bucket number, with room for every bucket the
+// buffer can hold.  The pyramid is built as frames arrive, and
+// GetPeaks() uses it to find the peaks of any range of samples in
+// time proportional to the log of its length.
+//
 
 class CWaveformBuffer
 {
 public:
+    // The lowest and highest sample in a range
+    struct Peak
+    {
+        short lo;
+        short hi;
+    };
+
     CWaveformBuffer(void);
     ~CWaveformBuffer(void);
 
     void Start(int p_channels, double p_sampleRate);
-    int  SetCapacity(double p_capacity) {m_capacity = p_capacity;}
+    void SetCapacity(double p_capacity) {m_capacity = p_capacity;}
+    void SetRing(bool p_ring) {m_ring = p_ring;}
     void End();
 
     void AddView(CWnd *p_wnd);
@@ -33,28 +56,87 @@ public:
     void UpdateAllViews();
 
     // Add a frame to the buffer
-    inline void Frame(short *p_frame)
+    inline void Frame(const short *p_frame)
     {
-        if(m_cnt < m_capacitySamples)
+        if(m_total >= m_limit)
+            return;
+
+        short *dest = &m_samples[m_pos];
+        for(int i=0;  i<m_channels;  i++)
+        {
+            dest[size_t(i) * m_capacitySamples] = p_frame[i];
+
+            Peak &peak = m_bucket[i];
+            if(p_frame[i] < peak.lo)
+                peak.lo = p_frame[i];
+            if(p_frame[i] > peak.hi)
+                peak.hi = p_frame[i];
+        }
+
+        m_total++;
+        if(++m_pos == m_capacitySamples)
+            m_pos = 0;
+
+        if((m_total & (PeakBucket - 1)) == 0)
+            AddPeaks();
+
+        if(--m_redraw == 0 || m_total == m_capacitySamples)
         {
-            for(int i=0;  i<m_channels;  i++)
-                m_buffer[i].push_back(p_frame[i]);
-            m_cnt++;
-            if((m_cnt % m_redrawRate) == 0 || m_cnt == m_capacitySamples)
-                UpdateAllViews();
+            m_redraw = m_redrawRate;
+            UpdateAllViews();
         }
     }
 
-    const std::vector<std::vector<short> > &GetWaveform() const {return m_buffer;}
+    // Add p_count interleaved frames to the buffer
+    void Frames(const short *p_frames, int p_count);
+
+    int GetChannels() const {return m_channels;}
+
+    // How many frames are in the buffer?
+    int GetSize() const {return m_total < m_capacitySamples ? int(m_total) : m_capacitySamples;}
+
+    // How many frames have been added since Start()?
+    long long GetTotal() const {return m_total;}
+
+    // Sample p_frame of a channel, counting from the oldest frame held
+    short GetSample(int p_channel, int p_frame) const
+    {
+        return m_samples[size_t(p_channel) * m_capacitySamples + Position(p_frame)];
+    }
+
+    // The peaks of samples p_begin up to p_end of a channel
+    Peak GetPeaks(int p_channel, int p_begin, int p_end) const;
 
 private:
-    std::vector<std::vector<short> >    m_buffer;   // The actual buffer
+    void AddPeaks();
+    void ClearBuckets();
+
+    // Where frame p_frame, counting from the oldest, is in the storage
+    int Position(long long p_frame) const
+    {
+        if(m_total > m_capacitySamples)
+            p_frame += m_total - m_capacitySamples;
+        return int(p_frame % m_capacitySamples);
+    }
+
+    // Samples in a level 0 peak, a power of two
+    static const int PeakShift = 4;
+    static const int PeakBucket = 1 << PeakShift;
+
+    std::vector<std::vector<std::vector<Peak> > > m_peaks;  // Peak pyramid for each channel
+    std::vector<Peak>                   m_bucket;   // Peaks of the bucket being filled
+
+    std::vector<short>                  m_samples;  // The actual buffer, one channel after another
     std::set<CWnd *>                    m_views;    // Views attached to this buffer
 
     int         m_channels;         // How many channels are defined?
     double      m_sampleRate;       // What is the sample rate?
     int         m_redrawRate;       // How often during loading should we force a redraw?
+    int         m_redraw;           // Frames until the next redraw
     double      m_capacity;         // What is the total capacity for the butter
+    bool        m_ring;             // Keep the most recent frames rather than the first?
     int         m_capacitySamples;  // What is the capacity in samples?
-    int         m_cnt;              // How many samples have been loaded in?
+    long long   m_limit;            // Frames accepted before we stop
+    long long   m_total;            // How many samples have been loaded in?
+    int         m_pos;              // Where the next frame goes
 };
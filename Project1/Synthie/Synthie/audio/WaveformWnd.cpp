@@ -8,6 +8,7 @@
 
 #include "pch.h"
 #include "WaveformWnd.h"
+#include <cmath>
 
 const int WSLIDERW = 25;            // Width of the slider in pixels...
 const int WSCROLLBARHEIGHT = 15;    // Height of the scroll bar
@@ -137,13 +138,13 @@ void CWaveformWnd::DrawWaveform(CDC * pDC)
     if(m_buffer == NULL)
         return;
 
-    const std::vector<std::vector<short> > &waveforms = m_buffer->GetWaveform();
+    int waveformsize = m_buffer->GetSize();
 
     //
     // Draw lines that separate into sections
     //
 
-    int channels = waveforms.size();
+    int channels = m_buffer->GetChannels();
 
     if(channels == 0)
     {
@@ -174,15 +175,11 @@ void CWaveformWnd::DrawWaveform(CDC * pDC)
     // Now draw each of the individual waveforms.
     //
 
-    double scale = 1. / (101 - m_scale.GetPos());
+    double spp = SamplesPerPixel(width);
+    double scale = 1. / spp;
 
     for(int c=0;  c<channels;  c++)
     {
-        // Now draw the actual waveform...
-        const std::vector<short> &waveform = waveforms[c];
-        int waveformsize = waveform.size();
-
-
         // We only set the scroll bar for the first channel, since all will be the same
         if(c == 0)
         {
@@ -194,7 +191,7 @@ void CWaveformWnd::DrawWaveform(CDC * pDC)
             si.fMask = SIF_PAGE | SIF_POS | SIF_RANGE;
             si.nMin = 0;
             si.nMax = waveformsize / scaling;
-            si.nPage = (int( (double)rect.Width() / scale)) / scaling;
+            si.nPage = (int( (double)rect.Width() * spp)) / scaling;
             si.nPos = m_offset / scaling;
             m_position.SetScrollInfo(&si);
         }
@@ -219,20 +216,45 @@ void CWaveformWnd::DrawWaveform(CDC * pDC)
         //
         pDC->SelectObject(&wavepen);
 
-        double x = rect.left + 1;
+        if(m_offset >= waveformsize)
+            continue;
 
-        std::vector<short>::const_iterator i=waveform.begin() + m_offset;
-        int y = center - (*i * (height / 2) / 32768);
-        pDC->MoveTo(int(x), y);
-        i++;
-        x += scale;
-
-        for(;  i!=waveform.end() && x < rect.right - 1;  i++)
+        if(spp < 2)
         {
-            int y = center - (*i * (height / 2) / 32768);
-            pDC->LineTo(int(x), y);
+            // Zoomed in, join up the samples
+            double x = rect.left + 1;
 
+            int i = m_offset;
+            int y = center - (m_buffer->GetSample(c, i) * (height / 2) / 32768);
+            pDC->MoveTo(int(x), y);
+            i++;
             x += scale;
+
+            for(;  i<waveformsize && x < rect.right - 1;  i++)
+            {
+                int y = center - (m_buffer->GetSample(c, i) * (height / 2) / 32768);
+                pDC->LineTo(int(x), y);
+
+                x += scale;
+            }
+        }
+        else
+        {
+            // Zoomed out, a line from the lowest to the highest
+            // sample under each pixel column
+            for(int px=0;  px < width;  px++)
+            {
+                int begin = m_offset + int(px * spp);
+                int end = m_offset + int((px + 1) * spp);
+                if(begin >= waveformsize)
+                    break;
+
+                CWaveformBuffer::Peak peak = m_buffer->GetPeaks(c, begin, end);
+
+                int x = rect.left + 1 + px;
+                pDC->MoveTo(x, center - (peak.hi * (height / 2) / 32768));
+                pDC->LineTo(x, center - (peak.lo * (height / 2) / 32768) + 1);
+            }
         }
     }
 
@@ -241,6 +263,24 @@ void CWaveformWnd::DrawWaveform(CDC * pDC)
 
 
 
+//
+// Name :         CWaveformWnd::SamplesPerPixel()
+// Description :  The scale slider zooms from one sample per pixel at
+//                the top to the whole waveform across the window at
+//                the bottom.
+//
+
+double CWaveformWnd::SamplesPerPixel(int p_width)
+{
+    double most = p_width > 0 ? double(m_buffer->GetSize()) / p_width : 1;
+    if(most < 1)
+        most = 1;
+
+    return pow(most, (100 - m_scale.GetPos()) / 100.);
+}
+
+
+
 void CWaveformWnd::OnMove(int x, int y)
 {
     CWnd::OnMove(x, y);
@@ -26,6 +26,7 @@ protected:
 
 private:
     void DrawWaveform(CDC * pDC);
+    double SamplesPerPixel(int p_width);
     void Resize();
 
     CSliderCtrl             m_scale;
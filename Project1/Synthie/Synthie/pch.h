@@ -6,6 +6,14 @@
 
 #pragma once
 
+#ifdef SYNTHIE_HEADLESS
+
+// Headless builds (see CMakeLists.txt) compile only the synthesizer
+// core, without MFC.
+#include "Portable.h"
+
+#else
+
 #ifndef _SECURE_ATL
 #define _SECURE_ATL 1
 #endif
@@ -38,14 +46,6 @@
 
 #include <afxcontrolbars.h>     // MFC support for ribbons and control bars
 
-const double PI = 3.1415926535897932384626433832795;
-
-
-
-
-
-
-
 #ifdef _UNICODE
 #if defined _M_IX86
 #pragma comment(linker,"/manifestdependency:\"type='win32' name='Microsoft.Windows.Common-Controls' version='6.0.0.0' processorArchitecture='x86' publicKeyToken='6595b64144ccf1df' language='*'\"")
@@ -58,4 +58,6 @@ const double PI = 3.1415926535897932384626433832795;
 #endif
 #endif
 
+#endif // SYNTHIE_HEADLESS
 
+const double PI = 3.1415926535897932384626433832795;
@@ -0,0 +1,473 @@
+//
+// Name :         SynthieBench.cpp
+// Description :  Microbenchmarks for the synthesis hot paths.  Times the
+//                synthesizer at several voice counts, the sine wave and
+//                each instrument per sample, wave file reading and
+//                writing, and score loading, and prints the results as
+//                JSON so they can be compared from one commit to the next.
+// Usage :        synthie-bench [-n runs] [-t threads] [-o out.json]
+//
+
+#include "pch.h"
+#include "CSynthesizer.h"
+#include "CSineWave.h"
+#include "CToneInstrument.h"
+#include "CWavetableInstrument.h"
+#include "CSampleBuffer.h"
+#include "Utf8.h"
+#include "audio/Wave.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+const double SampleRate = 44100;
+
+// Temporary files, made in the current directory
+const char* ScoreFile = "synthie-bench.score";
+const char* ScoreBinFile = "synthie-bench.scorebin";
+const char* WaveFile = "synthie-bench.wav";
+
+// Length of the wave the file benchmarks write and read
+const int WaveSeconds = 30;
+
+static void Usage()
+{
+    cerr << "usage: synthie-bench [-n runs] [-t threads] [-o out.json]" << endl;
+    cerr << "  -n runs     Times to run each benchmark, keeping the fastest (default 5)" << endl;
+    cerr << "  -t threads  Voice rendering threads for the synthesizer (default 1)" << endl;
+    cerr << "  -o file     Write the JSON results to file instead of the output" << endl;
+}
+
+//
+// One measurement, as it appears in the JSON
+//
+
+struct Result
+{
+    string name;
+    double value;
+    string unit;
+};
+
+static std::vector<Result> g_results;
+static int g_runs = 5;
+
+// Written by the benchmarks so the compiler can't drop their work
+static volatile double g_sink;
+
+static wstring Wide(const char* name)
+{
+    return Utf8ToWide(name, strlen(name));
+}
+
+//
+// Name :        Fastest()
+// Description : Run work g_runs times and return the fastest in seconds.
+//
+
+static double Fastest(const std::function<void()>& work)
+{
+    double best = 1e300;
+    for (int r = 0; r < g_runs; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        work();
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+static void Report(const string& name, double value, const string& unit)
+{
+    Result result = { name, value, unit };
+    g_results.push_back(result);
+    cerr << name << ": " << value << " " << unit << endl;
+}
+
+//
+// Name :        WriteToneScore()
+// Description : A score of tone notes, voices of them starting together
+//               on each of measures measures, each lasting seconds.
+//
+
+static bool WriteToneScore(const char* filename, int voices, int measures, double seconds)
+{
+    static const char* names[] = { "C3", "E3", "G3", "C4", "E4", "G4", "Bb4", "C5", "D5", "F#5", "A5", "C6" };
+
+    std::ofstream file(filename, std::ios::binary);
+    file << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+    file << "<score bpm=\"120\" beatspermeasure=\"4\">\n";
+    file << "   <instrument instrument=\"ToneInstrument\">\n";
+
+    // Durations are in beats at 120 bpm
+    char line[160];
+    for (int m = 0; m < measures; m++)
+    {
+        for (int v = 0; v < voices; v++)
+        {
+            snprintf(line, sizeof(line), "      <note measure=\"%d\" beat=\"1\" duration=\"%g\" note=\"%s\"/>\n",
+                m + 1, seconds * 2, names[v % 12]);
+            file << line;
+        }
+    }
+
+    file << "   </instrument>\n";
+    file << "</score>\n";
+    return bool(file);
+}
+
+//
+// Name :        Chord()
+// Description : One second of a stereo chord, as interleaved frames.
+//
+
+static const std::vector<float>& Chord()
+{
+    static std::vector<float> chord;
+    if (chord.empty())
+    {
+        const double pi = 3.14159265358979;
+        int frames = int(SampleRate);
+        chord.resize(frames * 2);
+        for (int i = 0; i < frames; i++)
+        {
+            double t = i / SampleRate;
+            chord[i * 2] = float(0.3 * sin(2 * pi * 220 * t) + 0.2 * sin(2 * pi * 277.18 * t));
+            chord[i * 2 + 1] = float(0.3 * sin(2 * pi * 329.63 * t) + 0.2 * sin(2 * pi * 440 * t));
+        }
+    }
+
+    return chord;
+}
+
+//
+// Name :        WriteWave()
+// Description : A stereo 16 bit wave of the chord, repeated for seconds.
+//
+
+static bool WriteWave(const char* filename, int seconds)
+{
+    const std::vector<float>& chord = Chord();
+
+    CWaveOut wave;
+    wave.NumChannels(2);
+    wave.SampleRate(SampleRate);
+    wave.open(Wide(filename).c_str());
+    if (wave.fail())
+        return false;
+
+    for (int s = 0; s < seconds; s++)
+        wave.WriteFrames(&chord[0], int(chord.size() / 2));
+
+    wave.close();
+    return !wave.fail();
+}
+
+//
+// The synthesizer, from the score, at several voice counts
+//
+
+static void BenchSynthesizer(int threads)
+{
+    const int counts[] = { 1, 16, 128, 1024 };
+
+    for (int voices : counts)
+    {
+        // Enough frames for about two million voice samples
+        int frames = 2000000 / voices;
+        if (frames > int(SampleRate))
+            frames = int(SampleRate);
+        if (frames < 4096)
+            frames = 4096;
+
+        WriteToneScore(ScoreFile, voices, 1, 60);
+
+        CSynthesizer synthesizer;
+        synthesizer.SetSampleRate(SampleRate);
+        synthesizer.SetNumThreads(threads);
+        if (!synthesizer.OpenScore(Wide(ScoreFile).c_str()))
+        {
+            wcerr << synthesizer.GetError() << endl;
+            continue;
+        }
+
+        double seconds = Fastest([&synthesizer, frames] {
+            double frame[2];
+            double sum = 0;
+
+            synthesizer.Start();
+            for (int i = 0; i < frames; i++)
+            {
+                synthesizer.Generate(frame);
+                sum += frame[0];
+            }
+
+            g_sink = sum;
+        });
+
+        string name = "synthesizer_generate_" + to_string(voices) + "_voices";
+        Report(name, seconds / frames * 1e9, "ns/frame");
+        Report(name + "_per_voice", seconds / frames / voices * 1e9, "ns/sample");
+    }
+
+    remove(ScoreFile);
+}
+
+//
+// A sparse score, a short note every measure and silence between,
+// rendered to the end
+//
+
+static void BenchSparse(int threads)
+{
+    WriteToneScore(ScoreFile, 1, 300, 0.1);
+
+    CSynthesizer synthesizer;
+    synthesizer.SetSampleRate(SampleRate);
+    synthesizer.SetNumThreads(threads);
+    if (!synthesizer.OpenScore(Wide(ScoreFile).c_str()))
+    {
+        wcerr << synthesizer.GetError() << endl;
+        return;
+    }
+
+    const int Block = 256;
+    long long frames = 0;
+
+    double seconds = Fastest([&synthesizer, &frames] {
+        float block[Block * 2];
+        double sum = 0;
+        int n;
+
+        frames = 0;
+        synthesizer.Start();
+        while ((n = synthesizer.GenerateBlock(block, Block)) > 0)
+        {
+            frames += n;
+            sum += block[0];
+        }
+
+        g_sink = sum;
+    });
+
+    Report("synthesizer_generate_sparse", seconds / frames * 1e9, "ns/frame");
+
+    remove(ScoreFile);
+}
+
+//
+// Per sample cost of a node, one sample at a time with Generate()
+// and a block at a time with GenerateBlock()
+//
+
+static void BenchNode(const string& name, CAudioNode& node)
+{
+    const int Samples = 1000000;
+    const int Block = 256;
+
+    double seconds = Fastest([&node] {
+        double sum = 0;
+
+        node.Start();
+        for (int i = 0; i < Samples; i++)
+        {
+            node.Generate();
+            sum += node.Frame(0);
+        }
+
+        g_sink = sum;
+    });
+
+    Report(name + "_generate", seconds / Samples * 1e9, "ns/sample");
+
+    std::vector<float> block(Block * 2);
+    seconds = Fastest([&node, &block] {
+        double sum = 0;
+
+        node.Start();
+        for (int i = 0; i < Samples / Block; i++)
+        {
+            node.GenerateBlock(&block[0], Block);
+            sum += block[0];
+        }
+
+        g_sink = sum;
+    });
+
+    Report(name + "_generate_block", seconds / (Samples / Block * Block) * 1e9, "ns/sample");
+}
+
+static void BenchNodes()
+{
+    CSineWave sine;
+    sine.SetSampleRate(SampleRate);
+    sine.SetFreq(440);
+    sine.SetAmplitude(0.5);
+    BenchNode("sinewave", sine);
+
+    // Long enough not to end during the benchmark
+    CToneInstrument tone;
+    tone.SetSampleRate(SampleRate);
+    tone.SetFreq(440);
+    tone.SetAmplitude(0.5);
+    tone.SetDuration(1e6);
+    BenchNode("tone", tone);
+
+    if (!WriteWave(WaveFile, 2))
+    {
+        cerr << "Unable to write " << WaveFile << endl;
+        return;
+    }
+
+    CWavetableInstrument wavetable;
+    wavetable.SetSampleRate(SampleRate);
+    wavetable.SetWave(CSampleBuffer::Load(Wide(WaveFile).c_str()));
+    wavetable.SetDuration(1e6);
+    BenchNode("wavetable", wavetable);
+
+    remove(WaveFile);
+}
+
+//
+// Wave file throughput, in MB of 16 bit stereo sample data a second
+//
+
+static void BenchWaveFiles()
+{
+    const int Block = 4096;
+    Chord();            // Made before the timing starts
+    double megabytes = WaveSeconds * SampleRate * 4 / (1024 * 1024);
+
+    double seconds = Fastest([] { WriteWave(WaveFile, WaveSeconds); });
+    Report("waveout_write", megabytes / seconds, "MB/s");
+
+    std::vector<float> block(Block * 2);
+    seconds = Fastest([&block] {
+        CWaveIn wave(Wide(WaveFile).c_str());
+        double sum = 0;
+        while (wave.ReadFrames(&block[0], Block) > 0)
+            sum += block[0];
+
+        g_sink = sum;
+    });
+
+    Report("wavein_read", megabytes / seconds, "MB/s");
+
+    remove(WaveFile);
+}
+
+//
+// Loading a score of many notes, from XML and compiled
+//
+
+static void BenchScoreLoad()
+{
+    const int Measures = 12500;
+    const int Voices = 8;
+    const int Notes = Measures * Voices;
+
+    WriteToneScore(ScoreFile, Voices, Measures, 1);
+
+    double seconds = Fastest([] {
+        CSynthesizer synthesizer;
+        synthesizer.OpenScore(Wide(ScoreFile).c_str());
+    });
+
+    Report("score_load_xml", seconds * 1000, "ms");
+    Report("score_load_xml_per_note", seconds / Notes * 1e9, "ns/note");
+
+    CSynthesizer compiler;
+    if (compiler.OpenScore(Wide(ScoreFile).c_str()) && compiler.SaveScoreBin(Wide(ScoreBinFile).c_str()))
+    {
+        seconds = Fastest([] {
+            CSynthesizer synthesizer;
+            synthesizer.OpenScore(Wide(ScoreBinFile).c_str());
+        });
+
+        Report("score_load_scorebin", seconds * 1000, "ms");
+    }
+
+    remove(ScoreFile);
+    remove(ScoreBinFile);
+}
+
+static void WriteJson(FILE* out, int threads)
+{
+    fprintf(out, "{\n");
+    fprintf(out, "  \"sample_rate\": %g,\n", SampleRate);
+    fprintf(out, "  \"threads\": %d,\n", threads);
+    fprintf(out, "  \"runs\": %d,\n", g_runs);
+    fprintf(out, "  \"benchmarks\": [\n");
+
+    for (size_t i = 0; i < g_results.size(); i++)
+    {
+        fprintf(out, "    {\"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\"}%s\n",
+            g_results[i].name.c_str(), g_results[i].value, g_results[i].unit.c_str(),
+            i + 1 < g_results.size() ? "," : "");
+    }
+
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char* argv[])
+{
+    int threads = 1;
+    const char* output = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if ((arg == "-n" || arg == "-t") && i + 1 < argc)
+        {
+            int value = atoi(argv[++i]);
+            if (arg == "-n")
+                g_runs = value;
+            else
+                threads = value;
+        }
+        else if (arg == "-o" && i + 1 < argc)
+        {
+            output = argv[++i];
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (g_runs < 1 || threads < 1)
+    {
+        Usage();
+        return 1;
+    }
+
+    BenchSynthesizer(threads);
+    BenchSparse(threads);
+    BenchNodes();
+    BenchWaveFiles();
+    BenchScoreLoad();
+
+    FILE* out = output != NULL ? fopen(output, "w") : stdout;
+    if (out == NULL)
+    {
+        cerr << "Unable to write " << output << endl;
+        return 1;
+    }
+
+    WriteJson(out, threads);
+
+    if (out != stdout)
+        fclose(out);
+
+    return 0;
+}
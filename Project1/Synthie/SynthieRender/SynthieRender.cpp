@@ -0,0 +1,261 @@
+//
+// Name :         SynthieRender.cpp
+// Description :  Headless renderer.  Renders a .score file to a .wav file
+//                with no user interface and reports how much faster than
+//                realtime it ran.
+// Usage :        synthie-render [-r rate] [-b frames] [-t threads] [-s MB] [-u tuning.scl] [-m voices] [-k policy] [-f] [-p] [-v] in.score out.wav
+//
+
+#include "pch.h"
+#include "CSynthesizer.h"
+#include "CRenderThread.h"
+#include "Utf8.h"
+#include "audio/Wave.h"
+#include "audio/NullAudioStream.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+static void Usage()
+{
+    cerr << "usage: synthie-render [-r rate] [-b frames] [-t threads] [-s MB] [-u tuning.scl] [-m voices] [-k policy] [-f] [-p] [-v] in.score out.wav" << endl;
+    cerr << "  -r rate     Sample rate in samples per second (default 44100)" << endl;
+    cerr << "  -b frames   Render block size in frames, 64 to 1024 (default 256)" << endl;
+    cerr << "  -t threads  Voice rendering threads (default one per core)" << endl;
+    cerr << "  -s MB       Stream waves bigger than this from disk (default 64, 0 never)" << endl;
+    cerr << "  -u file     Tune notes with a Scala .scl scale instead of equal temperament" << endl;
+    cerr << "  -m voices   Play at most this many voices at once, stealing the rest" << endl;
+    cerr << "  -k policy   Voice to steal: oldest, quietest, or priority (default oldest)" << endl;
+    cerr << "  -f          Write 32 bit float samples instead of 16 bit" << endl;
+    cerr << "  -p          Also play through a simulated real time output and report its latency" << endl;
+    cerr << "  -v          Report the render's statistics every second and at the end" << endl;
+}
+
+//
+// Print a line of the synthesizer's render statistics
+//
+
+static void PrintStats(const CRenderStats& stats, double sampleRate)
+{
+    fprintf(stderr, "%.1f s: %d voices (peak %d, %lld stolen, %lld retired silent), %.0f note-ons/s, %.1fx realtime, "
+        "dispatch %.3f s, render %.3f s, mix %.3f s, advance %.3f s\n",
+        stats.frames / sampleRate,
+        stats.activeVoices, stats.peakVoices, stats.voicesStolen, stats.voicesRetired, stats.noteOnsPerSecond, stats.realtimeFactor,
+        stats.dispatchSeconds, stats.renderSeconds, stats.mixSeconds, stats.advanceSeconds);
+}
+
+int main(int argc, char* argv[])
+{
+    const int channels = 2;
+    double sampleRate = 44100;
+    int blockSize = 0;
+    int threads = 0;
+    double streamMB = -1;
+    bool floatSamples = false;
+    bool play = false;
+    bool verbose = false;
+    int maxVoices = 0;
+    CSynthesizer::StealPolicy policy = CSynthesizer::StealOldest;
+    const char* tuning = NULL;
+    std::vector<const char*> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if ((arg == "-r" || arg == "-b" || arg == "-t" || arg == "-s" || arg == "-m") && i + 1 < argc)
+        {
+            double value = atof(argv[++i]);
+            if (arg == "-r")
+                sampleRate = value;
+            else if (arg == "-b")
+                blockSize = int(value);
+            else if (arg == "-s")
+                streamMB = value;
+            else if (arg == "-m")
+                maxVoices = int(value);
+            else
+                threads = int(value);
+        }
+        else if (arg == "-k" && i + 1 < argc)
+        {
+            string value = argv[++i];
+            if (value == "oldest")
+                policy = CSynthesizer::StealOldest;
+            else if (value == "quietest")
+                policy = CSynthesizer::StealQuietest;
+            else if (value == "priority")
+                policy = CSynthesizer::StealLowestPriority;
+            else
+            {
+                Usage();
+                return 1;
+            }
+        }
+        else if (arg == "-u" && i + 1 < argc)
+        {
+            tuning = argv[++i];
+        }
+        else if (arg == "-f")
+        {
+            floatSamples = true;
+        }
+        else if (arg == "-p")
+        {
+            play = true;
+        }
+        else if (arg == "-v")
+        {
+            verbose = true;
+        }
+        else if (arg[0] == '-')
+        {
+            Usage();
+            return 1;
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (files.size() != 2 || sampleRate <= 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    wstring scoreName = Utf8ToWide(files[0], strlen(files[0]));
+    wstring waveName = Utf8ToWide(files[1], strlen(files[1]));
+
+    //
+    // Load the score
+    //
+
+    CSynthesizer synthesizer;
+    synthesizer.SetNumChannels(channels);
+    synthesizer.SetSampleRate(sampleRate);
+    if (blockSize > 0)
+        synthesizer.SetBlockSize(blockSize);
+    if (threads > 0)
+        synthesizer.SetNumThreads(threads);
+    if (streamMB >= 0)
+        synthesizer.SetStreamThreshold(size_t(streamMB * 1024 * 1024));
+
+    synthesizer.SetMaxPolyphony(maxVoices);
+    synthesizer.SetStealPolicy(policy);
+
+    if (tuning != NULL && !synthesizer.LoadTuning(Utf8ToWide(tuning, strlen(tuning)).c_str()))
+    {
+        wcerr << synthesizer.GetError() << endl;
+        return 1;
+    }
+
+    // There is no deadline here, so streamed waves wait for the disk
+    synthesizer.SetStreamBlocking(true);
+
+    if (!synthesizer.OpenScore(scoreName.c_str()))
+    {
+        wcerr << synthesizer.GetError() << endl;
+        return 1;
+    }
+
+    CWaveOut wave;
+    wave.NumChannels(channels);
+    wave.SampleRate(sampleRate);
+    wave.FloatSamples(floatSamples);
+    wave.open(waveName.c_str());
+    if (wave.fail())
+        return 1;
+
+    CNullAudioStream stream;
+    stream.SetChannels(channels);
+    stream.SetSampleRate(int(sampleRate));
+    if (play)
+        stream.Open();
+
+    //
+    // Render it
+    //
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Synthesis runs on its own thread, a queue of blocks ahead of the outputs
+    CRenderThread render;
+    render.Start(&synthesizer);
+
+    blockSize = render.BlockSize();
+    std::vector<float> block(blockSize * channels);
+    std::vector<short> samples(blockSize * channels);
+    long long total = 0;
+    auto report = start;
+
+    int frames;
+    while ((frames = render.Pop(&block[0])) > 0)
+    {
+        // The render thread is still going; its stats are a snapshot
+        if (verbose && std::chrono::steady_clock::now() - report >= std::chrono::seconds(1))
+        {
+            PrintStats(synthesizer.GetRenderStats(), sampleRate);
+            report = std::chrono::steady_clock::now();
+        }
+
+        // The wave file is written on its own thread
+        if (!wave.WriteFrames(&block[0], frames))
+        {
+            render.Cancel();
+            break;
+        }
+
+        if (play)
+        {
+            for (int i = 0; i < frames * channels; i++)
+            {
+                float d = block[i] * 32767.f;
+                samples[i] = short(d < -32768 ? -32768 : d > 32767 ? 32767 : d);
+            }
+
+            stream.WriteFrames(&samples[0], frames);
+        }
+
+        total += frames;
+    }
+
+    render.Stop();
+    wave.close();
+    stream.Close();
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double seconds = total / sampleRate;
+
+    printf("Rendered %.2f seconds of audio in %.3f seconds (%.1fx realtime)\n",
+        seconds, elapsed, elapsed > 0 ? seconds / elapsed : 0.);
+
+    if (play)
+    {
+        printf("Output latency at most %.1f ms, %lld frames of underrun\n",
+            stream.MaxLatency() * 1000, stream.Underruns());
+    }
+
+    if (verbose)
+    {
+        CRenderStats stats = synthesizer.GetRenderStats();
+        PrintStats(stats, sampleRate);
+
+        for (size_t i = 0; i < stats.instruments.size(); i++)
+        {
+            if (stats.instruments[i].samples > 0)
+            {
+                fprintf(stderr, "%s: %lld voice frames, %.1f cycles per frame\n",
+                    WideToUtf8(synthesizer.GetInstrumentName(int(i)).c_str()).c_str(),
+                    stats.instruments[i].samples, stats.instruments[i].cyclesPerSample);
+            }
+        }
+    }
+
+    if (synthesizer.GetStreamUnderruns() > 0)
+        printf("%lld frames of streamed waves were not read in time\n", synthesizer.GetStreamUnderruns());
+
+    return wave.fail() ? 1 : 0;
+}
@@ -0,0 +1,394 @@
+//
+// Name :         AudioStreamTest.cpp
+// Description :  Checks the lock-free ring between an audio producer
+//                and its device thread, on its own and then behind
+//                the null output stream: frames come out in the order
+//                they went in as the positions wrap, a full ring takes
+//                no more and an empty one gives nothing, and underruns
+//                and latency are counted when the producer falls
+//                behind or runs ahead of the device.
+//
+
+#include "pch.h"
+#include "audio/AudioRing.h"
+#include "audio/NullAudioStream.h"
+#include "Check.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+const int Channels = 2;
+const int SampleRate = 44100;
+
+//
+// The test signal counts frames from 1, never 0, so silence the
+// device plays can be told from frames we wrote.  Each channel of a
+// frame holds the same count.
+//
+
+static short FrameValue(long long frame)
+{
+    return short(frame % 32767 + 1);
+}
+
+static void FillFrames(std::vector<short>& buffer, long long first, int frames)
+{
+    buffer.resize(size_t(frames) * Channels);
+    for (int i = 0; i < frames; i++)
+    {
+        for (int c = 0; c < Channels; c++)
+            buffer[i * Channels + c] = FrameValue(first + i);
+    }
+}
+
+//
+// Name :         CheckFrames()
+// Description :  Check that frames read from a ring or played by a
+//                device continue the count from next, which is
+//                advanced past them.  Returns false at the first frame
+//                out of order.
+//
+
+static bool CheckFrames(const short* frames, int count, long long& next)
+{
+    for (int i = 0; i < count; i++, next++)
+    {
+        for (int c = 0; c < Channels; c++)
+        {
+            if (frames[i * Channels + c] != FrameValue(next))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+//
+// Name :         CheckRingWrap()
+// Description :  Write and read in chunks that don't divide the
+//                capacity, so both positions wrap many times and
+//                reads and writes split across the end of the ring.
+//
+
+static void CheckRingWrap()
+{
+    CAudioRing ring;
+    ring.Allocate(100, Channels);
+
+    CHECK(ring.Capacity() == 128);
+    CHECK(ring.Filled() == 0);
+    CHECK(ring.Space() == 128);
+
+    std::vector<short> in, out(128 * Channels);
+    long long written = 0, read = 0;
+    bool ordered = true;
+
+    for (int step = 0; step < 10000; step++)
+    {
+        int toWrite = 1 + step % 37;
+        FillFrames(in, written, toWrite);
+        int n = ring.Write(&in[0], toWrite);
+        written += n;
+
+        int toRead = 1 + step % 53;
+        int m = ring.Read(&out[0], toRead);
+        if (!CheckFrames(&out[0], m, read))
+            ordered = false;
+
+        CHECK(ring.Filled() == written - read);
+        CHECK(ring.Space() == ring.Capacity() - ring.Filled());
+    }
+
+    CHECK(ordered);
+    CHECK(written > 100 * ring.Capacity());
+}
+
+//
+// Name :         CheckRingLimits()
+// Description :  A writer ahead of the reader fills the ring and no
+//                more; a reader ahead of the writer empties it and
+//                gets nothing more.
+//
+
+static void CheckRingLimits()
+{
+    CAudioRing ring;
+    ring.Allocate(64, Channels);
+
+    std::vector<short> in, out(200 * Channels);
+    long long next = 0;
+
+    // Reading an empty ring gives nothing
+    CHECK(ring.Read(&out[0], 10) == 0);
+
+    // Writing more than fits takes what fits
+    FillFrames(in, 0, 200);
+    CHECK(ring.Write(&in[0], 200) == 64);
+    CHECK(ring.Filled() == 64);
+    CHECK(ring.Space() == 0);
+    CHECK(ring.Write(&in[64 * Channels], 1) == 0);
+
+    // Make room for some, then a write fills exactly that room
+    CHECK(ring.Read(&out[0], 20) == 20);
+    CHECK(CheckFrames(&out[0], 20, next));
+    CHECK(ring.Write(&in[64 * Channels], 50) == 20);
+
+    // Asking for more than is there gives what is there
+    CHECK(ring.Read(&out[0], 200) == 64);
+    CHECK(CheckFrames(&out[0], 64, next));
+    CHECK(ring.Filled() == 0);
+    CHECK(ring.Read(&out[0], 1) == 0);
+
+    // Clear starts over
+    CHECK(ring.Write(&in[0], 10) == 10);
+    ring.Clear();
+    CHECK(ring.Filled() == 0);
+    CHECK(ring.Space() == 64);
+}
+
+//
+// Name :         CheckRingThreads()
+// Description :  A producer and a consumer thread pass a few million
+//                frames through a small ring.  Each side stalls now
+//                and then, so the consumer both falls behind the
+//                producer and catches up to it.
+//
+
+static void CheckRingThreads()
+{
+    const long long Frames = 2000000;
+
+    CAudioRing ring;
+    ring.Allocate(256, Channels);
+
+    std::thread producer([&ring] {
+        std::vector<short> in;
+        long long written = 0;
+        for (int step = 0; written < Frames; step++)
+        {
+            int n = 1 + step % 97;
+            if (n > Frames - written)
+                n = int(Frames - written);
+
+            FillFrames(in, written, n);
+            for (int done = 0; done < n; )
+            {
+                int w = ring.Write(&in[done * Channels], n - done);
+                done += w;
+                if (w == 0)
+                    std::this_thread::yield();
+            }
+
+            written += n;
+            if (step % 5000 == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    std::vector<short> out(256 * Channels);
+    long long read = 0;
+    bool ordered = true;
+
+    for (int step = 0; read < Frames; step++)
+    {
+        int n = ring.Read(&out[0], 1 + step % 131);
+        if (!CheckFrames(&out[0], n, read))
+        {
+            ordered = false;
+            break;
+        }
+
+        if (n == 0)
+            std::this_thread::yield();
+
+        if (step % 7000 == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    producer.join();
+
+    CHECK(ordered);
+    CHECK(read == Frames);
+    CHECK(ring.Filled() == 0);
+}
+
+//
+// A null stream that keeps what it plays
+//
+
+class CRecordingStream : public CNullAudioStream
+{
+public:
+    std::vector<short> m_played;
+
+protected:
+    virtual void PlayDevice(const short *frames, int count)
+    {
+        m_played.insert(m_played.end(), frames, frames + size_t(count) * Channels);
+    }
+};
+
+//
+// Name :         CheckPlayed()
+// Description :  Check that the frames a stream played are the count
+//                from 0 to frames, in order, with only silence between
+//                and after them.
+//
+
+static void CheckPlayed(const CRecordingStream& stream, long long frames)
+{
+    long long next = 0;
+    bool ordered = true;
+
+    for (size_t i = 0; i < stream.m_played.size(); i += Channels)
+    {
+        if (stream.m_played[i] == 0)
+            continue;
+
+        if (next >= frames || !CheckFrames(&stream.m_played[i], 1, next))
+        {
+            ordered = false;
+            break;
+        }
+    }
+
+    CHECK(ordered);
+    CHECK(next == frames);
+    CHECK((long long)stream.m_played.size() / Channels == stream.FramesPlayed());
+}
+
+//
+// Name :         CheckStreamNotRealtime()
+// Description :  A device that plays whatever it is given at once
+//                never runs dry, whatever the producer does.
+//
+
+static void CheckStreamNotRealtime()
+{
+    const int Frames = 200000;
+
+    CRecordingStream stream;
+    stream.SetRealtime(false);
+    stream.SetChannels(Channels);
+    stream.SetSampleRate(SampleRate);
+    stream.SetBufferDuration(0.01);
+    stream.SetPeriodDuration(0.002);
+    CHECK(stream.Open());
+
+    std::vector<short> in;
+    for (int written = 0; written < Frames; )
+    {
+        int n = 1000;
+        FillFrames(in, written, n);
+        stream.WriteFrames(&in[0], n);
+        written += n;
+    }
+
+    CHECK(stream.Close());
+
+    CheckPlayed(stream, Frames);
+    CHECK(stream.Underruns() == 0);
+    CHECK(stream.FramesPlayed() >= Frames);
+
+    // The ring is the buffer duration rounded up to a power of two
+    CHECK(stream.MaxLatency() <= double(512 + stream.PeriodFrames()) / SampleRate);
+}
+
+//
+// Name :         CheckStreamBehind()
+// Description :  A producer that stops writing for a while leaves the
+//                real time device playing silence, which is counted as
+//                underruns; what was written still plays in order.
+//
+
+static void CheckStreamBehind()
+{
+    const int Chunk = 441;
+
+    CRecordingStream stream;
+    stream.SetChannels(Channels);
+    stream.SetSampleRate(SampleRate);
+    stream.SetBufferDuration(0.02);
+    stream.SetPeriodDuration(0.005);
+    CHECK(stream.Open());
+
+    std::vector<short> in;
+    FillFrames(in, 0, Chunk);
+    stream.WriteFrames(&in[0], Chunk);
+    CHECK(stream.Underruns() == 0);
+
+    // Well past the ring and the device's period
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    long long underruns = stream.Underruns();
+    CHECK(underruns > 0);
+    CHECK(stream.Latency() <= double(stream.PeriodFrames()) / SampleRate);
+
+    FillFrames(in, Chunk, Chunk);
+    stream.WriteFrames(&in[0], Chunk);
+    CHECK(stream.Close());
+
+    // Silence while closing is not counted
+    CHECK(stream.Underruns() >= underruns);
+    CheckPlayed(stream, 2 * Chunk);
+}
+
+//
+// Name :         CheckStreamAhead()
+// Description :  A producer that writes faster than real time is held
+//                back by the full ring, so the latency it sees stays
+//                within the ring and the device never runs dry.
+//
+
+static void CheckStreamAhead()
+{
+    const int Frames = SampleRate / 4;
+
+    CRecordingStream stream;
+    stream.SetChannels(Channels);
+    stream.SetSampleRate(SampleRate);
+    stream.SetBufferDuration(0.1);
+    stream.SetPeriodDuration(0.005);
+    CHECK(stream.Open());
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<short> in;
+    for (int written = 0; written < Frames; )
+    {
+        int n = 2048;
+        if (n > Frames - written)
+            n = Frames - written;
+
+        FillFrames(in, written, n);
+        stream.WriteFrames(&in[0], n);
+        written += n;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Everything past the ring had to wait for the device to play
+    CHECK(seconds >= double(Frames - 8192 - stream.PeriodFrames()) / SampleRate * 0.9);
+
+    // The ring is the buffer duration rounded up to a power of two
+    CHECK(stream.MaxLatency() <= double(8192 + stream.PeriodFrames()) / SampleRate);
+    CHECK(stream.MaxLatency() >= 0.1);
+
+    CHECK(stream.Close());
+
+    CHECK(stream.Underruns() == 0);
+    CheckPlayed(stream, Frames);
+}
+
+int main()
+{
+    CheckRingWrap();
+    CheckRingLimits();
+    CheckRingThreads();
+
+    CheckStreamNotRealtime();
+    CheckStreamBehind();
+    CheckStreamAhead();
+
+    return CheckResult();
+}
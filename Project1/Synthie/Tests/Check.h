@@ -0,0 +1,40 @@
+//
+// Name :         Check.h
+// Description :  The check macro the headless tests share.  Each test
+//                is its own executable that reports the checks that
+//                failed and returns nonzero if there were any, which
+//                is all ctest needs.  Failures are reported on stdout,
+//                since the core reports wave file errors on wcerr and
+//                stderr can't take narrow output after wide.
+//
+
+#pragma once
+#include <cstdio>
+
+static int g_failures = 0;
+
+#define CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failures++; \
+        } \
+    } while (0)
+
+//
+// Name :         CheckResult()
+// Description :  What main() returns once the checks are done.
+//
+
+inline int CheckResult()
+{
+    if (g_failures > 0)
+    {
+        printf("%d checks failed\n", g_failures);
+        return 1;
+    }
+
+    return 0;
+}
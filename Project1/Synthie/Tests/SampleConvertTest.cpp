@@ -0,0 +1,140 @@
+//
+// Name :         SampleConvertTest.cpp
+// Description :  Checks every ConvertSamples() kernel against a plain
+//                scalar conversion, for every count up to a few
+//                vectors so each tail length is covered, at unaligned
+//                source and destination addresses, and for the
+//                largest and smallest values of each format.
+//
+
+#include "pch.h"
+#include "audio/SampleConvert.h"
+#include "Check.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Counts up to this cover every tail of the widest kernel several times
+const int MaxCount = 70;
+
+//
+// Name :         Reference()
+// Description :  One sample converted the obvious way.
+//
+
+static float Reference(const unsigned char* p, int bytes, bool isFloat)
+{
+    if (isFloat)
+    {
+        float f;
+        memcpy(&f, p, sizeof(f));
+        return f;
+    }
+
+    switch (bytes)
+    {
+    case 1:
+        return (p[0] - 128) / 128.f;
+
+    case 2:
+        return short(p[0] | (p[1] << 8)) / 32768.f;
+
+    case 3:
+    {
+        int value = p[0] | (p[1] << 8) | (p[2] << 16);
+        if (value & 0x800000)
+            value -= 0x1000000;
+        return value / 8388608.f;
+    }
+
+    default:
+    {
+        long long value = p[0] | (p[1] << 8) | (p[2] << 16) | ((long long)p[3] << 24);
+        if (value & 0x80000000LL)
+            value -= 0x100000000LL;
+        return float(value / 2147483648.0);
+    }
+    }
+}
+
+//
+// Name :         CheckFormat()
+// Description :  Convert every count from 0 to MaxCount samples of one
+//                format, at each alignment, and compare them exactly
+//                with Reference().  Checks that nothing past the last
+//                sample is written.
+//
+
+static void CheckFormat(int bytes, bool isFloat)
+{
+    const float Guard = 12345.f;
+
+    std::vector<unsigned char> src((MaxCount + 4) * bytes + 16);
+    std::vector<float> dst(MaxCount + 8);
+
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (unsigned char)rand();
+
+    // Extremes of each format at the start, where every kernel sees them
+    if (!isFloat)
+    {
+        memset(&src[0], 0x00, bytes);
+        memset(&src[bytes], 0xff, bytes);
+        memset(&src[bytes * 2], 0x00, bytes);
+        memset(&src[bytes * 3], 0x00, bytes);
+        src[bytes * 2 + bytes - 1] = 0x80;  // Most negative
+        src[bytes * 3 + bytes - 1] = 0x7f;  // Most positive
+        memset(&src[bytes * 3], 0xff, bytes - 1);
+    }
+
+    for (int align = 0; align < 4; align++)
+    {
+        const unsigned char* in = &src[align * bytes + align];
+        float* out = &dst[align];
+
+        for (int count = 0; count <= MaxCount; count++)
+        {
+            for (size_t i = 0; i < dst.size(); i++)
+                dst[i] = Guard;
+
+            CHECK(ConvertSamples(out, in, count, bytes, isFloat));
+
+            int wrong = 0;
+            for (int i = 0; i < count; i++)
+            {
+                float expect = Reference(in + i * bytes, bytes, isFloat);
+                if (memcmp(&out[i], &expect, sizeof(float)) != 0)
+                    wrong++;
+            }
+
+            if (wrong > 0)
+            {
+                printf("%d byte%s samples, count %d, alignment %d: %d wrong\n",
+                    bytes, isFloat ? " float" : "", count, align, wrong);
+            }
+
+            CHECK(wrong == 0);
+            CHECK(out[count] == Guard);
+        }
+    }
+}
+
+int main()
+{
+    CheckFormat(1, false);
+    CheckFormat(2, false);
+    CheckFormat(3, false);
+    CheckFormat(4, false);
+    CheckFormat(4, true);
+
+    // Formats we don't know leave the destination alone
+    float dst[4] = {1, 1, 1, 1};
+    unsigned char src[16] = {0};
+    CHECK(!ConvertSamples(dst, src, 4, 5, false));
+    CHECK(!ConvertSamples(dst, src, 4, 2, true));
+    CHECK(!ConvertSamples(dst, src, 4, 8, true));
+    CHECK(dst[0] == 1 && dst[3] == 1);
+
+    return CheckResult();
+}
@@ -0,0 +1,385 @@
+//
+// Name :         ScoreBinTest.cpp
+// Description :  Round trip test of the .scorebin compiled score format.
+//                Compiles each score in the directory it is given, and
+//                one it writes with wavetable waves, maps the .scorebin
+//                back, and checks that the tempo, waves, notes and the
+//                rendered audio are the same as from the XML.  Then
+//                checks that truncated and damaged files are refused,
+//                and that every note plays when the sample rate is
+//                lowered after a .scorebin is opened.
+// Usage :        synthie-test-scorebin scoredir
+//
+
+#include "pch.h"
+#include "CSynthesizer.h"
+#include "CScoreBin.h"
+#include "Utf8.h"
+#include "audio/Wave.h"
+#include "Check.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+const double SampleRate = 44100;
+
+// Files the test writes, in the current directory
+const char* BinFile = "synthie-test.scorebin";
+const char* DamagedFile = "synthie-test-damaged.scorebin";
+const char* WaveScoreFile = "synthie-test-waves.score";
+const char* RateScoreFile = "synthie-test-rate.score";
+const char* WaveFiles[] = { "synthie-test-a.wav", "synthie-test-b.wav" };
+
+static wstring Wide(const std::string& name)
+{
+    return Utf8ToWide(name.c_str(), name.size());
+}
+
+static bool SameNote(const CNote& a, const CNote& b)
+{
+    return a.Instrument() == b.Instrument() && a.Measure() == b.Measure() && a.Beat() == b.Beat() &&
+        a.Duration() == b.Duration() && a.Frequency() == b.Frequency() && a.WaveIndex() == b.WaveIndex();
+}
+
+//
+// Name :         Render()
+// Description :  Render a score to the end, returning its frames.
+//
+
+static std::vector<float> Render(CSynthesizer& synthesizer)
+{
+    const int Block = 512;
+
+    std::vector<float> audio;
+    float block[Block * 2];
+    int n;
+
+    synthesizer.Start();
+    while ((n = synthesizer.GenerateBlock(block, Block)) > 0)
+        audio.insert(audio.end(), block, block + n * 2);
+
+    return audio;
+}
+
+//
+// Name :         CheckRoundTrip()
+// Description :  Compile a score and check the .scorebin plays the
+//                same as the score.
+//
+
+static void CheckRoundTrip(const std::string& score)
+{
+    CSynthesizer original;
+    original.SetSampleRate(SampleRate);
+    CHECK(original.OpenScore(Wide(score).c_str()));
+    CHECK(original.GetNumNotes() > 0);
+
+    // Waves are found relative to the .scorebin, so this finds the
+    // ones the wave score writes next to it, in the current directory
+    std::string bin = BinFile;
+    CHECK(original.SaveScoreBin(Wide(bin).c_str()));
+
+    CSynthesizer compiled;
+    compiled.SetSampleRate(SampleRate);
+    if (!compiled.OpenScore(Wide(bin).c_str()))
+    {
+        printf("%s: %s\n", bin.c_str(), WideToUtf8(compiled.GetError().c_str()).c_str());
+        CHECK(false);
+        remove(bin.c_str());
+        return;
+    }
+
+    CHECK(compiled.GetBpm() == original.GetBpm());
+    CHECK(compiled.GetBeatsPerMeasure() == original.GetBeatsPerMeasure());
+    CHECK(compiled.GetScoreWaves() == original.GetScoreWaves());
+    CHECK(compiled.GetScoreFrames() == original.GetScoreFrames());
+    CHECK(compiled.GetNumNotes() == original.GetNumNotes());
+
+    int differ = 0;
+    for (size_t i = 0; i < original.GetNumNotes() && i < compiled.GetNumNotes(); i++)
+    {
+        if (!SameNote(original.GetNotes()[i], compiled.GetNotes()[i]))
+            differ++;
+    }
+
+    CHECK(differ == 0);
+
+    std::vector<float> expect = Render(original);
+    std::vector<float> audio = Render(compiled);
+    CHECK(!expect.empty());
+    CHECK(audio.size() == expect.size());
+    CHECK(audio.size() == expect.size() && memcmp(&audio[0], &expect[0], audio.size() * sizeof(float)) == 0);
+
+    // The score has to make some sound for the comparison to mean much
+    float peak = 0;
+    for (float sample : expect)
+        peak = fabs(sample) > peak ? fabs(sample) : peak;
+    CHECK(peak > 0.01f);
+
+    if (differ > 0 || audio != expect)
+        printf("%s does not play the same compiled\n", score.c_str());
+
+    remove(bin.c_str());
+}
+
+//
+// Name :         WriteWaveScore()
+// Description :  Write a score that plays two waves on the wavetable
+//                instrument, along with tone notes, and the waves.
+//
+
+static bool WriteWaveScore()
+{
+    for (int w = 0; w < 2; w++)
+    {
+        CWaveOut wave;
+        wave.NumChannels(2);
+        wave.SampleRate(SampleRate);
+        wave.open(Wide(WaveFiles[w]).c_str());
+        if (wave.fail())
+            return false;
+
+        // Half a second of a different pitch for each
+        std::vector<float> frames(size_t(SampleRate / 2) * 2);
+        for (size_t i = 0; i < frames.size() / 2; i++)
+            frames[i * 2] = frames[i * 2 + 1] = float(0.5 * sin(2 * PI * 220 * (w + 1) * i / SampleRate));
+
+        wave.WriteFrames(&frames[0], int(frames.size() / 2));
+        wave.close();
+        if (wave.fail())
+            return false;
+    }
+
+    FILE* file = fopen(WaveScoreFile, "w");
+    if (file == NULL)
+        return false;
+
+    fprintf(file, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n");
+    fprintf(file, "<score bpm=\"90\" beatspermeasure=\"3\">\n");
+    fprintf(file, "<instrument instrument=\"WavetableInstrument\">\n");
+    fprintf(file, "<wavetable><wav path=\"%s\"/><wav path=\"%s\"/></wavetable>\n", WaveFiles[0], WaveFiles[1]);
+    for (int n = 0; n < 12; n++)
+    {
+        fprintf(file, "<note measure=\"%d\" beat=\"%g\" duration=\"0.5\" note=\"C4\" wave=\"%d\"/>\n",
+            1 + n / 3, 1 + (n % 3) * 0.75, 1 + n % 2);
+    }
+
+    fprintf(file, "</instrument>\n");
+    fprintf(file, "<instrument instrument=\"ToneInstrument\">\n");
+    fprintf(file, "<note measure=\"2\" beat=\"1.5\" duration=\"2\" note=\"E4\"/>\n");
+    fprintf(file, "<note measure=\"3\" beat=\"2\" duration=\"1\" note=\"G4+25\"/>\n");
+    fprintf(file, "</instrument>\n");
+    fprintf(file, "</score>\n");
+
+    return fclose(file) == 0;
+}
+
+//
+// Name :         CheckRefused()
+// Description :  Write bytes as a .scorebin and check it can't be opened.
+//
+
+static void CheckRefused(const std::vector<char>& bytes, const char* what)
+{
+    {
+        std::ofstream file(DamagedFile, std::ios::binary);
+        file.write(bytes.data(), bytes.size());
+    }
+
+    CScoreBin bin;
+    std::wstring error;
+    bool opened = bin.Open(Wide(DamagedFile).c_str(), error);
+    if (opened)
+        printf("A .scorebin %s was opened\n", what);
+
+    CHECK(!opened);
+    CHECK(!error.empty());
+    CHECK(!bin.IsOpen());
+
+    remove(DamagedFile);
+}
+
+//
+// Write a value into a copy of a file at an offset
+//
+
+template<class T> static std::vector<char> Patch(const std::vector<char>& bytes, size_t offset, T value)
+{
+    std::vector<char> patched = bytes;
+    memcpy(&patched[offset], &value, sizeof(value));
+    return patched;
+}
+
+template<class T> static T Field(const std::vector<char>& bytes, size_t offset)
+{
+    T value;
+    memcpy(&value, &bytes[offset], sizeof(value));
+    return value;
+}
+
+//
+// Name :         CheckDamaged()
+// Description :  Compile a score, then check that truncated copies of
+//                it and copies with damaged headers and tables are all
+//                refused, and the file itself is not.
+//
+
+static void CheckDamaged(const std::string& score)
+{
+    typedef CScoreBin::Header Header;
+
+    CSynthesizer synthesizer;
+    synthesizer.SetSampleRate(SampleRate);
+    CHECK(synthesizer.OpenScore(Wide(score).c_str()));
+    CHECK(synthesizer.SaveScoreBin(Wide(BinFile).c_str()));
+
+    std::vector<char> bytes;
+    {
+        std::ifstream file(BinFile, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    remove(BinFile);
+
+    CHECK(bytes.size() > sizeof(Header));
+    if (bytes.size() <= sizeof(Header))
+        return;
+
+    // The file as written opens
+    {
+        std::ofstream file(BinFile, std::ios::binary);
+        file.write(bytes.data(), bytes.size());
+    }
+
+    CScoreBin bin;
+    std::wstring error;
+    CHECK(bin.Open(Wide(BinFile).c_str(), error));
+    bin.Close();
+    remove(BinFile);
+
+    // Truncated anywhere
+    const size_t lengths[] = { 0, 4, sizeof(Header) - 1, sizeof(Header),
+        size_t(Field<uint64_t>(bytes, offsetof(Header, noteOffset))) + 1, bytes.size() / 2, bytes.size() - 1 };
+    for (size_t length : lengths)
+    {
+        CheckRefused(std::vector<char>(bytes.begin(), bytes.begin() + length), "truncated");
+    }
+
+    // Damaged header
+    CheckRefused(Patch<char>(bytes, offsetof(Header, magic), 'X'), "with a bad magic number");
+    CheckRefused(Patch<uint32_t>(bytes, offsetof(Header, version), CScoreBin::Version + 1), "from another version");
+    CheckRefused(Patch<uint32_t>(bytes, offsetof(Header, byteOrder), 0x04030201), "in the other byte order");
+    CheckRefused(Patch<uint32_t>(bytes, offsetof(Header, noteSize), sizeof(CNote) + 8), "with another note size");
+    CheckRefused(Patch<uint32_t>(bytes, offsetof(Header, numTempos), 0), "with no tempo");
+    CheckRefused(Patch<uint64_t>(bytes, offsetof(Header, numNotes), 1ull << 60), "with too many notes");
+    CheckRefused(Patch<uint64_t>(bytes, offsetof(Header, noteOffset),
+        Field<uint64_t>(bytes, offsetof(Header, noteOffset)) + 4), "with misaligned notes");
+    CheckRefused(Patch<uint64_t>(bytes, offsetof(Header, stringOffset), bytes.size() + 8), "with strings past its end");
+    CheckRefused(Patch<uint64_t>(bytes, offsetof(Header, stringSize), 0), "with no strings");
+    CheckRefused(Patch<double>(bytes, offsetof(Header, polyphonyRate), 0), "with a polyphony rate of 0");
+    CheckRefused(Patch<double>(bytes, offsetof(Header, polyphonyRate), INFINITY), "with an infinite polyphony rate");
+
+    // Damaged tables
+    size_t tempo = size_t(Field<uint64_t>(bytes, offsetof(Header, tempoOffset)));
+    CheckRefused(Patch<double>(bytes, tempo + offsetof(CScoreBin::Tempo, bpm), 0), "with a tempo of 0");
+    CheckRefused(Patch<double>(bytes, tempo + offsetof(CScoreBin::Tempo, bpm), NAN), "with a tempo that is not a number");
+    CheckRefused(Patch<uint32_t>(bytes, tempo + offsetof(CScoreBin::Tempo, beatsPerMeasure), 0), "with no beats per measure");
+
+    size_t instrument = size_t(Field<uint64_t>(bytes, offsetof(Header, instrumentOffset)));
+    CheckRefused(Patch<uint32_t>(bytes, instrument + offsetof(CScoreBin::Instrument, name), 0x7fffffff),
+        "with an instrument name past the strings");
+    CheckRefused(Patch<int32_t>(bytes, instrument + offsetof(CScoreBin::Instrument, peakPolyphony), 0x7fffffff),
+        "with more voices at once than notes");
+    CheckRefused(Patch<int32_t>(bytes, instrument + offsetof(CScoreBin::Instrument, peakPolyphony), -1),
+        "with a negative peak polyphony");
+}
+
+//
+// Name :         CheckRateChange()
+// Description :  Compile a score of short notes with short gaps at one
+//                sample rate and play it at a lower one.  The gaps are
+//                wider than a block at the first rate, so the peak in
+//                the file is one voice, but narrower than a block at
+//                the second, so each note needs a voice of its own
+//                until the one before it is returned to the pool.
+//
+
+static void CheckRateChange()
+{
+    const int Notes = 20;
+
+    FILE* file = fopen(RateScoreFile, "w");
+    CHECK(file != NULL);
+    if (file == NULL)
+        return;
+
+    // 0.1 second notes every 0.15 seconds
+    fprintf(file, "<score bpm=\"120\" beatspermeasure=\"4\">\n");
+    fprintf(file, "<instrument instrument=\"ToneInstrument\">\n");
+    for (int n = 0; n < Notes; n++)
+        fprintf(file, "<note measure=\"1\" beat=\"%g\" duration=\"0.2\" note=\"A4\"/>\n", 1 + n * 0.3);
+
+    fprintf(file, "</instrument>\n");
+    fprintf(file, "</score>\n");
+    CHECK(fclose(file) == 0);
+
+    CSynthesizer original;
+    original.SetSampleRate(SampleRate);
+    CHECK(original.OpenScore(Wide(RateScoreFile).c_str()));
+    CHECK(original.SaveScoreBin(Wide(BinFile).c_str()));
+
+    CSynthesizer compiled;
+    compiled.SetSampleRate(SampleRate);
+    compiled.SetBlockSize(1024);
+    CHECK(compiled.OpenScore(Wide(BinFile).c_str()));
+    compiled.SetSampleRate(8000);
+
+    CSynthesizer direct;
+    direct.SetSampleRate(8000);
+    direct.SetBlockSize(1024);
+    CHECK(direct.OpenScore(Wide(RateScoreFile).c_str()));
+
+    std::vector<float> audio = Render(compiled);
+    CHECK(compiled.GetRenderStats().notesStarted == Notes);
+    CHECK(audio == Render(direct));
+
+    remove(BinFile);
+    remove(RateScoreFile);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        printf("usage: synthie-test-scorebin scoredir\n");
+        return 1;
+    }
+
+    std::string dir = std::string(argv[1]) + "/";
+    const char* scores[] = { "test1.score", "test2.score", "fight.score", "fight2.score" };
+
+    for (const char* score : scores)
+    {
+        CheckRoundTrip(dir + score);
+    }
+
+    CHECK(WriteWaveScore());
+    CheckRoundTrip(WaveScoreFile);
+
+    CheckDamaged(dir + "test1.score");
+    CheckDamaged(WaveScoreFile);
+
+    CheckRateChange();
+
+    remove(WaveScoreFile);
+    remove(WaveFiles[0]);
+    remove(WaveFiles[1]);
+
+    return CheckResult();
+}
@@ -0,0 +1,141 @@
+//
+// Name :         SilenceTest.cpp
+// Description :  Checks when the synthesizer retires silent voices.  A
+//                wave that starts with silence longer than the silence
+//                time has to play in full, while one that sounds and
+//                then goes quiet is retired before the end of its note.
+//
+
+#include "pch.h"
+#include "CSynthesizer.h"
+#include "Utf8.h"
+#include "audio/Wave.h"
+#include "Check.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+const double SampleRate = 44100;
+
+// Files the test writes, in the current directory
+const char* ScoreFile = "synthie-test-silence.score";
+const char* WaveFile = "synthie-test-silence.wav";
+
+static wstring Wide(const char* name)
+{
+    return Utf8ToWide(name, strlen(name));
+}
+
+//
+// Name :         WriteScore()
+// Description :  Write a mono wave of silent seconds, then tone seconds
+//                of 440 Hz, then silent seconds again, and a score that
+//                plays it with one note of duration beats at 120 bpm.
+//
+
+static bool WriteScore(double silent, double tone, double after, double duration)
+{
+    CWaveOut wave;
+    wave.NumChannels(1);
+    wave.SampleRate(SampleRate);
+    wave.open(Wide(WaveFile).c_str());
+    if (wave.fail())
+        return false;
+
+    int lead = int(silent * SampleRate);
+    int sound = int(tone * SampleRate);
+    std::vector<float> frames(lead + sound + int(after * SampleRate));
+    for (int i = 0; i < sound; i++)
+        frames[lead + i] = float(0.5 * sin(2 * PI * 440 * i / SampleRate));
+
+    wave.WriteFrames(&frames[0], int(frames.size()));
+    wave.close();
+    if (wave.fail())
+        return false;
+
+    FILE* file = fopen(ScoreFile, "w");
+    if (file == NULL)
+        return false;
+
+    fprintf(file, "<score bpm=\"120\" beatspermeasure=\"4\">\n");
+    fprintf(file, "<instrument instrument=\"WavetableInstrument\">\n");
+    fprintf(file, "<wavetable><wav path=\"%s\"/></wavetable>\n", WaveFile);
+    fprintf(file, "<note measure=\"1\" beat=\"1\" duration=\"%g\" note=\"C4\"/>\n", duration);
+    fprintf(file, "</instrument>\n");
+    fprintf(file, "</score>\n");
+
+    return fclose(file) == 0;
+}
+
+//
+// Name :         Render()
+// Description :  Render the score to the end, returning the frames
+//                rendered and the loudest sample.
+//
+
+static long long Render(CSynthesizer& synthesizer, float& peak)
+{
+    const int Block = 256;
+
+    float block[Block * 2];
+    long long frames = 0;
+    int n;
+
+    peak = 0;
+    synthesizer.Start();
+    while ((n = synthesizer.GenerateBlock(block, Block)) > 0)
+    {
+        for (int i = 0; i < n * 2; i++)
+            peak = fabs(block[i]) > peak ? fabs(block[i]) : peak;
+
+        frames += n;
+    }
+
+    return frames;
+}
+
+int main()
+{
+    float peak;
+
+    // Silence at the start, twice the default silence time, is played
+    // through, and so is the tone after it, which the half second note
+    // ends in the middle of
+    CHECK(WriteScore(0.2, 0.5, 0, 1));
+    {
+        CSynthesizer synthesizer;
+        synthesizer.SetSampleRate(SampleRate);
+        CHECK(synthesizer.OpenScore(Wide(ScoreFile).c_str()));
+
+        long long frames = Render(synthesizer, peak);
+        CHECK(peak > 0.4f);
+        CHECK(frames >= synthesizer.GetScoreFrames());
+        CHECK(synthesizer.GetRenderStats().voicesRetired == 0);
+    }
+
+    // A voice that sounds and then goes silent is retired early
+    CHECK(WriteScore(0, 0.2, 2, 4));
+    {
+        CSynthesizer synthesizer;
+        synthesizer.SetSampleRate(SampleRate);
+        CHECK(synthesizer.OpenScore(Wide(ScoreFile).c_str()));
+
+        long long frames = Render(synthesizer, peak);
+        CHECK(peak > 0.4f);
+        CHECK(frames < synthesizer.GetScoreFrames());
+        CHECK(synthesizer.GetRenderStats().voicesRetired == 1);
+
+        // Unless retiring is turned off
+        synthesizer.SetSilence(0, 0);
+        frames = Render(synthesizer, peak);
+        CHECK(frames >= synthesizer.GetScoreFrames());
+        CHECK(synthesizer.GetRenderStats().voicesRetired == 0);
+    }
+
+    remove(ScoreFile);
+    remove(WaveFile);
+
+    return CheckResult();
+}
@@ -0,0 +1,91 @@
+//
+// Name :         SineTest.cpp
+// Description :  Checks CSineWave::GenerateBlock against std::sin.  The
+//                block generator rotates float phasors rather than
+//                calling sin(), so this checks that its error stays
+//                within the documented 1e-5 of the amplitude, and that
+//                the phase carried from block to block does not drift
+//                over several seconds.
+//
+
+#include "pch.h"
+#include "CSineWave.h"
+#include "Check.h"
+
+#include <cmath>
+#include <vector>
+
+const double SampleRate = 44100;
+
+// Largest error allowed, as a fraction of the amplitude
+const double MaxError = 1e-5;
+
+//
+// Name :         CheckSine()
+// Description :  Generate seconds of a sine wave in blocks of block
+//                frames and compare every sample, in both channels,
+//                with sin() of the exact phase of its frame.
+//
+
+static void CheckSine(double freq, double amp, int block, double seconds)
+{
+    CSineWave sine;
+    sine.SetSampleRate(SampleRate);
+    sine.SetFreq(freq);
+    sine.SetAmplitude(amp);
+    sine.Start();
+
+    long long frames = (long long)(seconds * SampleRate);
+    double step = freq / SampleRate;
+    std::vector<float> out(block * 2);
+    double worst = 0;
+    bool matched = true;
+
+    for (long long n = 0; n < frames; n += block)
+    {
+        CHECK(sine.GenerateBlock(&out[0], block));
+
+        for (int i = 0; i < block; i++)
+        {
+            // The phase in cycles, reduced before it is scaled to
+            // radians so it stays exact for long runs
+            double cycles = (n + i) * step;
+            double expect = amp * sin(2 * PI * (cycles - floor(cycles)));
+            double error = fabs(out[i * 2] - expect) / amp;
+            if (error > worst)
+                worst = error;
+
+            if (out[i * 2] != out[i * 2 + 1])
+                matched = false;
+        }
+    }
+
+    if (worst > MaxError)
+    {
+        printf("%g Hz in blocks of %d: error %g of the amplitude\n", freq, block, worst);
+    }
+
+    CHECK(worst <= MaxError);
+    CHECK(matched);
+}
+
+int main()
+{
+    const double freqs[] = {27.5, 440, 1234.567, 4186.01, 15000};
+    const int blocks[] = {1024, 512, 100, 7, 1};
+
+    for (double freq : freqs)
+    {
+        for (int block : blocks)
+        {
+            CheckSine(freq, 1, block, 5);
+        }
+    }
+
+    // Another amplitude, and a long run in the largest blocks for drift
+    CheckSine(440, 0.1, 1024, 5);
+    CheckSine(440, 1, 1024, 60);
+    CheckSine(15000, 1, 1024, 60);
+
+    return CheckResult();
+}
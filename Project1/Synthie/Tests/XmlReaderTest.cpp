@@ -0,0 +1,87 @@
+//
+// Name :         XmlReaderTest.cpp
+// Description :  Checks that the XML reader replaces character entities
+//                and references in attribute values with their UTF-8,
+//                and refuses references that are not characters.
+//
+
+#include "pch.h"
+#include "XmlReader.h"
+#include "Check.h"
+
+#include <cstring>
+#include <string>
+
+//
+// Name :         Value()
+// Description :  Read an element whose one attribute holds value, and
+//                return what the reader makes of it.
+// Returns :      false if the reader finds an error.
+//
+
+static bool Value(const char* value, std::string& result)
+{
+    std::string text = std::string("<note name=\"") + value + "\"/>";
+
+    CXmlReader xml;
+    xml.SetText(text.c_str(), text.size());
+    if (xml.Next() != CXmlReader::StartElement || xml.NumAttributes() != 1)
+        return false;
+
+    result = xml.AttributeValue(0);
+    return true;
+}
+
+static void CheckValue(const char* value, const char* expect)
+{
+    std::string result;
+    bool read = Value(value, result);
+    if (!read || result != expect)
+        printf("\"%s\" was not read as \"%s\"\n", value, expect);
+
+    CHECK(read);
+    CHECK(result == expect);
+}
+
+static void CheckRefused(const char* value)
+{
+    std::string result;
+    bool read = Value(value, result);
+    if (read)
+        printf("\"%s\" was read\n", value);
+
+    CHECK(!read);
+}
+
+int main()
+{
+    CheckValue("C4", "C4");
+    CheckValue("&lt;&gt;&amp;&quot;&apos;", "<>&\"'");
+    CheckValue("&#65;&#x42;&#x43;", "ABC");
+
+    // One, two, three and four byte UTF-8
+    CheckValue("&#x7f;", "\x7f");
+    CheckValue("&#233;", "\xc3\xa9");
+    CheckValue("&#x266F;", "\xe2\x99\xaf");
+    CheckValue("&#x1D122;", "\xf0\x9d\x84\xa2");
+    CheckValue("&#x10FFFF;", "\xf4\x8f\xbf\xbf");
+
+    // Not digits, not all digits, or not a character
+    CheckRefused("&#;");
+    CheckRefused("&#x;");
+    CheckRefused("&#xZZ;");
+    CheckRefused("&#12a;");
+    CheckRefused("&#x41 ;");
+    CheckRefused("&# 65;");
+    CheckRefused("&#-65;");
+    CheckRefused("&#X41;");
+    CheckRefused("&#0;");
+    CheckRefused("&#x0000;");
+    CheckRefused("&#xD800;");
+    CheckRefused("&#x110000;");
+    CheckRefused("&#99999999999999999999;");
+    CheckRefused("&unknown;");
+    CheckRefused("&#65");
+
+    return CheckResult();
+}